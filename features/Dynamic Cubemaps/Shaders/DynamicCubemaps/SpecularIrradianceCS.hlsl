@@ -14,6 +14,7 @@ static const float InvNumSamples = 1.0 / float(NumSamples);
 cbuffer SpecularMapFilterSettings : register(b0)
 {
 	float roughness;
+	uint faceOffset;  // first face of this dispatch when the prefilter is split across frames
 };
 
 TextureCube inputTexture : register(t0);
@@ -137,6 +138,8 @@ float3 Lin2sRGB(float3 color)
 		return;
 	}
 
+	ThreadID.z += faceOffset;
+
 	// Get input cubemap dimensions at zero mipmap level.
 	float inputWidth, inputHeight, inputLevels;
 	inputTexture.GetDimensions(0, inputWidth, inputHeight, inputLevels);
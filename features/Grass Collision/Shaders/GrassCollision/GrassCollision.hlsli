@@ -7,15 +7,27 @@ cbuffer GrassCollisionPerFrame : register(b5)
 	float RadiusMultiplier;
 	float DisplacementMultiplier;
 	float maxDistance;
+	float4 GridOrigin[2];  // camera-relative corner of the collision grid for each eye
 }
 
+// Must match GrassCollision.h
+#define COLLISION_GRID_SIZE 32
+#define COLLISION_GRID_CELL_SIZE 128.0
+
 struct StructuredCollision
 {
 	float3 centre[2];
 	float radius;
 };
 
-StructuredBuffer<StructuredCollision> collisions : register(t0);
+struct CollisionCell
+{
+	uint offset;
+	uint count;
+};
+
+StructuredBuffer<StructuredCollision> collisions : register(t0);  // grouped by grid cell
+StructuredBuffer<CollisionCell> collisionGrid : register(t1);
 
 float3 GetDisplacedPosition(float3 position, float alpha, uint eyeIndex = 0)
 {
@@ -31,10 +43,13 @@ float3 GetDisplacedPosition(float3 position, float alpha, uint eyeIndex = 0)
 	}
 
 	if (EnableGrassCollision) {
-		uint counter = 0;
-		uint collision_count, dummy;
-		collisions.GetDimensions(collision_count, dummy);
-		for (uint collision_index = 0; collision_index < collision_count; collision_index++) {
+		// Only colliders overlapping this vertex's grid cell can displace it
+		int2 cell = floor((worldPosition.xy - GridOrigin[eyeIndex].xy) / COLLISION_GRID_CELL_SIZE);
+		if (any(cell < 0) || any(cell >= COLLISION_GRID_SIZE))
+			return 0;
+
+		CollisionCell gridCell = collisionGrid[cell.x + cell.y * COLLISION_GRID_SIZE];
+		for (uint collision_index = gridCell.offset; collision_index < gridCell.offset + gridCell.count; collision_index++) {
 			StructuredCollision collision = collisions[collision_index];
 
 			float dist = distance(collision.centre[eyeIndex], worldPosition);
@@ -38,6 +38,7 @@ bool LightIntersectsCluster(StructuredLight light, ClusterAABB cluster, int eyeI
 	}
 
 	uint visibleLightCount = 0;
+	uint totalLightCount = 0;
 	uint visibleLightIndices[MAX_CLUSTER_LIGHTS];
 
 	uint clusterIndex = groupIndex + GROUP_SIZE * groupId.z;
@@ -59,19 +60,26 @@ bool LightIntersectsCluster(StructuredLight light, ClusterAABB cluster, int eyeI
 		GroupMemoryBarrierWithGroupSync();
 
 		for (uint i = 0; i < batchSize; i++) {
-			StructuredLight light = lights[i];
+			StructuredLight light = sharedLights[i];
 
-			if (visibleLightCount < MAX_CLUSTER_LIGHTS && (LightIntersectsCluster(light, cluster)
+			// Lights arrive sorted by importance, so a full cluster keeps the strongest ones
+			if (LightIntersectsCluster(light, cluster)
 #ifdef VR
-															  || LightIntersectsCluster(light, cluster, 1)
+				|| LightIntersectsCluster(light, cluster, 1)
 #endif  // VR
-																  )) {
-				visibleLightIndices[visibleLightCount] = lightOffset + i;
-				visibleLightCount++;
+			) {
+				if (visibleLightCount < MAX_CLUSTER_LIGHTS) {
+					visibleLightIndices[visibleLightCount] = lightOffset + i;
+					visibleLightCount++;
+				}
+				totalLightCount++;
 			}
 		}
 
 		lightOffset += batchSize;
+
+		// the next batch overwrites sharedLights
+		GroupMemoryBarrierWithGroupSync();
 	}
 
 	GroupMemoryBarrierWithGroupSync();
@@ -85,6 +93,7 @@ bool LightIntersectsCluster(StructuredLight light, ClusterAABB cluster, int eyeI
 
 	lightGrid[clusterIndex].offset = offset;
 	lightGrid[clusterIndex].lightCount = visibleLightCount;
+	lightGrid[clusterIndex].totalLightCount = totalLightCount;
 }
 
 //https://www.3dgep.com/forward-plus/#Grid_Frustums_Compute_Shader
@@ -16,7 +16,8 @@ struct LightGrid
 {
 	uint offset;
 	uint lightCount;
-	float pad0[2];
+	uint totalLightCount;  // intersecting lights before the MAX_CLUSTER_LIGHTS cap
+	float pad0;
 };
 
 struct StructuredLight
@@ -2,7 +2,8 @@ struct LightGrid
 {
 	uint offset;
 	uint lightCount;
-	float pad0[2];
+	uint totalLightCount;
+	float pad0;
 };
 
 struct StructuredLight
@@ -0,0 +1,106 @@
+#include "BindingCache.h"
+
+template <class T, uint N>
+void BindingCache::Slots<T, N>::Stage(uint a_startSlot, uint a_count, T* const* a_values)
+{
+	for (uint i = 0; i < a_count && a_startSlot + i < N; i++) {
+		pending[a_startSlot + i] = a_values[i];
+		staged.set(a_startSlot + i);
+	}
+}
+
+template <class T, uint N>
+void BindingCache::Slots<T, N>::Invalidate(uint a_startSlot, uint a_count)
+{
+	for (uint i = a_startSlot; i < a_startSlot + a_count && i < N; i++)
+		known.reset(i);
+}
+
+template <class T, uint N>
+template <class Apply>
+uint32_t BindingCache::Slots<T, N>::Flush(Apply a_apply)
+{
+	if (staged.none())
+		return 0;
+
+	uint32_t calls = 0;
+	auto changed = [&](uint slot) { return !known[slot] || bound[slot] != pending[slot]; };
+
+	for (uint slot = 0; slot < N;) {
+		if (!staged[slot] || !changed(slot)) {
+			slot++;
+			continue;
+		}
+
+		// extend over staged slots, ending the call at the last one that changed
+		uint start = slot;
+		uint last = slot;
+		for (slot++; slot < N && staged[slot]; slot++) {
+			if (changed(slot))
+				last = slot;
+		}
+
+		uint count = last - start + 1;
+		a_apply(start, count, &pending[start]);
+		calls++;
+		for (uint i = start; i <= last; i++) {
+			bound[i] = pending[i];
+			known.set(i);
+		}
+	}
+
+	staged.reset();
+	return calls;
+}
+
+void BindingCache::SetShaderResources(Stage a_stage, uint a_startSlot, uint a_count, ID3D11ShaderResourceView* const* a_views)
+{
+	requestedSlots += a_count;
+	shaderResources[(size_t)a_stage].Stage(a_startSlot, a_count, a_views);
+}
+
+void BindingCache::SetConstantBuffers(Stage a_stage, uint a_startSlot, uint a_count, ID3D11Buffer* const* a_buffers)
+{
+	requestedSlots += a_count;
+	constantBuffers[(size_t)a_stage].Stage(a_startSlot, a_count, a_buffers);
+}
+
+void BindingCache::Flush(ID3D11DeviceContext* a_context)
+{
+	constexpr auto vertex = (size_t)Stage::Vertex;
+	constexpr auto pixel = (size_t)Stage::Pixel;
+
+	issuedCalls += shaderResources[vertex].Flush([&](uint start, uint count, ID3D11ShaderResourceView* const* views) { a_context->VSSetShaderResources(start, count, views); });
+	issuedCalls += shaderResources[pixel].Flush([&](uint start, uint count, ID3D11ShaderResourceView* const* views) { a_context->PSSetShaderResources(start, count, views); });
+	issuedCalls += constantBuffers[vertex].Flush([&](uint start, uint count, ID3D11Buffer* const* buffers) { a_context->VSSetConstantBuffers(start, count, buffers); });
+	issuedCalls += constantBuffers[pixel].Flush([&](uint start, uint count, ID3D11Buffer* const* buffers) { a_context->PSSetConstantBuffers(start, count, buffers); });
+}
+
+void BindingCache::InvalidateShaderResources(Stage a_stage, uint a_startSlot, uint a_count)
+{
+	shaderResources[(size_t)a_stage].Invalidate(a_startSlot, a_count);
+}
+
+void BindingCache::InvalidateShaderResources()
+{
+	for (auto& slots : shaderResources)
+		slots.Invalidate(0, ShaderResourceSlots);
+}
+
+void BindingCache::InvalidateGameSlots()
+{
+	for (auto& slots : shaderResources)
+		slots.Invalidate(0, GameShaderResourceSlots);
+	for (auto& slots : constantBuffers)
+		slots.Invalidate(0, GameConstantBufferSlots);
+}
+
+void BindingCache::Reset()
+{
+	for (auto& slots : shaderResources)
+		slots.Invalidate(0, ShaderResourceSlots);
+	for (auto& slots : constantBuffers)
+		slots.Invalidate(0, ConstantBufferSlots);
+	requestedSlotsLastFrame = std::exchange(requestedSlots, 0);
+	issuedCallsLastFrame = std::exchange(issuedCalls, 0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+/**
+ * Shadow copy of the shader resource and constant buffer slots that features bind for draws.
+ * Binds are staged and applied by Flush, which skips slots that already hold the requested object and
+ * merges contiguous changed slots into a single call.
+ * The game rebinds its own low slots through BSGraphics::SetDirtyStates without going through here,
+ * so those are forgotten before every draw; feature slots above them stay valid until Reset.
+ * Any code that binds a cached slot directly must invalidate it, and binding a UAV or render target
+ * silently unbinds every SRV of the same resource, so those binds must invalidate all shader resources.
+ */
+class BindingCache
+{
+public:
+	static BindingCache* GetSingleton()
+	{
+		static BindingCache singleton;
+		return &singleton;
+	}
+
+	enum class Stage
+	{
+		Vertex,
+		Pixel,
+		Total
+	};
+
+	void SetShaderResources(Stage a_stage, uint a_startSlot, uint a_count, ID3D11ShaderResourceView* const* a_views);
+	void SetConstantBuffers(Stage a_stage, uint a_startSlot, uint a_count, ID3D11Buffer* const* a_buffers);
+
+	/** Apply staged bindings to the context. */
+	void Flush(ID3D11DeviceContext* a_context);
+
+	void InvalidateShaderResources(Stage a_stage, uint a_startSlot, uint a_count);
+	/** Forget every shader resource slot; call after binding UAVs or render targets. */
+	void InvalidateShaderResources();
+	/** Forget the slots the game manages itself; called before each draw. */
+	void InvalidateGameSlots();
+	/** Forget everything; called once per frame. */
+	void Reset();
+
+	// Per-frame counters: slots features asked to bind and the calls that reached the context
+	uint32_t requestedSlots = 0;
+	uint32_t issuedCalls = 0;
+	uint32_t requestedSlotsLastFrame = 0;
+	uint32_t issuedCallsLastFrame = 0;
+
+private:
+	static constexpr uint ShaderResourceSlots = D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT;
+	static constexpr uint ConstantBufferSlots = D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT;
+	static constexpr uint GameShaderResourceSlots = 16;
+	static constexpr uint GameConstantBufferSlots = 5;
+
+	template <class T, uint N>
+	struct Slots
+	{
+		std::array<T*, N> bound{};
+		std::array<T*, N> pending{};
+		std::bitset<N> known;   // bound[] matches the context
+		std::bitset<N> staged;  // pending[] holds a bind to apply
+
+		void Stage(uint a_startSlot, uint a_count, T* const* a_values);
+		void Invalidate(uint a_startSlot, uint a_count);
+		template <class Apply>
+		uint32_t Flush(Apply a_apply);
+	};
+
+	std::array<Slots<ID3D11ShaderResourceView, ShaderResourceSlots>, (size_t)Stage::Total> shaderResources;
+	std::array<Slots<ID3D11Buffer, ConstantBufferSlots>, (size_t)Stage::Total> constantBuffers;
+};
@@ -1,4 +1,5 @@
 #include "Bindings.h"
+#include "BindingCache.h"
 #include "State.h"
 #include "Util.h"
 
@@ -217,6 +218,7 @@ void Bindings::SetDirtyStates(bool)
 			REL::Relocation<_VR_OMSetRenderTargets> VR_OMSetRenderTargets{ REL::Offset(0x0dc4240) };
 			VR_OMSetRenderTargets(renderTargetViews, newDepthStencil, viewCount);
 		}
+		BindingCache::GetSingleton()->InvalidateShaderResources();
 		stateUpdateFlags.reset(RE::BSGraphics::ShaderFlags::DIRTY_RENDERTARGET, RE::BSGraphics::ShaderFlags::DIRTY_VRPREVIEW);
 	}
 
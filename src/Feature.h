@@ -11,6 +11,19 @@ struct Feature
 	virtual std::string_view GetShaderDefineName() { return ""; }
 
 	virtual bool HasShaderDefine(RE::BSShader::Type) { return false; }
+	/**
+	 * Whether Draw does any work for a shader type.
+	 * State builds per-type dispatch lists from this, so Draw is only called for these types.
+	 *
+	 * \return true if Draw should be called for draws of this type
+	 */
+	virtual bool HasDraw(RE::BSShader::Type) { return true; }
+	/**
+	 * Whether the feature overrides DrawDeferred or DrawPreProcess.
+	 * Passes with no participating feature skip their state save and restore.
+	 */
+	virtual bool HasDrawDeferred() { return false; }
+	virtual bool HasDrawPreProcess() { return false; }
 	/**
 	 * Whether the feature supports VR.
 	 * 
@@ -2,6 +2,7 @@
 
 #include "State.h"
 
+#include "BindingCache.h"
 #include "Util.h"
 
 #include "magic_enum_flags.hpp"
@@ -110,8 +111,11 @@ void CloudShadows::ModifySky(const RE::BSShader*, const uint32_t descriptor)
 		auto& device = State::GetSingleton()->device;
 
 		{
+			// unbind now, the occlusion cubemap becomes a render target below
 			ID3D11ShaderResourceView* srv = nullptr;
-			context->PSSetShaderResources(40, 1, &srv);
+			auto bindingCache = BindingCache::GetSingleton();
+			bindingCache->SetShaderResources(BindingCache::Stage::Pixel, 40, 1, &srv);
+			bindingCache->Flush(context);
 		}
 
 		auto reflections = renderer->GetRendererData().cubemapRenderTargets[RE::RENDER_TARGET_CUBEMAP::kREFLECTIONS];
@@ -134,6 +138,7 @@ void CloudShadows::ModifySky(const RE::BSShader*, const uint32_t descriptor)
 
 		rtvs[3] = cubemapCloudOccRTVs[side];
 		context->OMSetRenderTargets(4, rtvs, depthStencil);
+		BindingCache::GetSingleton()->InvalidateShaderResources();
 
 		// blend states
 
@@ -175,15 +180,15 @@ void CloudShadows::ModifyLighting()
 			context->GenerateMips(texCubemapCloudOcc->srv.get());
 
 		auto srv = texCubemapCloudOcc->srv.get();
-		context->PSSetShaderResources(40, 1, &srv);
+		BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 40, 1, &srv);
 	} else {
 		ID3D11ShaderResourceView* srv = nullptr;
-		context->PSSetShaderResources(40, 1, &srv);
+		BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 40, 1, &srv);
 	}
 
 	ID3D11ShaderResourceView* views[1]{};
 	views[0] = perPass->srv.get();
-	context->PSSetShaderResources(23, ARRAYSIZE(views), views);
+	BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 23, ARRAYSIZE(views), views);
 }
 
 void CloudShadows::Draw(const RE::BSShader* shader, const uint32_t descriptor)
@@ -221,6 +226,19 @@ void CloudShadows::Draw(const RE::BSShader* shader, const uint32_t descriptor)
 	}
 }
 
+bool CloudShadows::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Sky:
+	case RE::BSShader::Type::Lighting:
+	case RE::BSShader::Type::DistantTree:
+	case RE::BSShader::Type::Grass:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void CloudShadows::Load(json& o_json)
 {
 	if (o_json[GetName()].is_object())
@@ -57,6 +57,7 @@ struct CloudShadows : Feature
 	void ModifySky(const RE::BSShader* shader, const uint32_t descriptor);
 	void ModifyLighting();
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor) override;
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json) override;
 	virtual void Save(json& o_json) override;
@@ -133,6 +133,16 @@ void DistantTreeLighting::Draw(const RE::BSShader* shader, const uint32_t descri
 	}
 }
 
+bool DistantTreeLighting::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::DistantTree:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void DistantTreeLighting::Load(json& o_json)
 {
 	if (o_json[GetName()].is_object())
@@ -44,6 +44,7 @@ struct DistantTreeLighting : Feature
 	virtual void DrawSettings();
 	void ModifyDistantTree(const RE::BSShader* shader, const uint32_t descriptor);
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
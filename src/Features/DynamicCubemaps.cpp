@@ -1,5 +1,6 @@
 #include "DynamicCubemaps.h"
 
+#include "BindingCache.h"
 #include "Util.h"
 
 #include <DDSTextureLoader.h>
@@ -7,6 +8,16 @@
 
 constexpr auto MIPLEVELS = 10;
 
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+	DynamicCubemaps::Settings,
+	EnableTimeSlicing,
+	PrefilterBudget,
+	EnableChangeDetection,
+	CameraThreshold,
+	ViewThreshold,
+	SunThreshold,
+	ColorThreshold)
+
 void DynamicCubemaps::DrawSettings()
 {
 	if (ImGui::TreeNodeEx("Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -105,6 +116,36 @@ void DynamicCubemaps::DrawSettings()
 		ImGui::Spacing();
 		ImGui::Spacing();
 
+		ImGui::Checkbox("Time Slicing", (bool*)&settings.EnableTimeSlicing);
+		if (auto _tt = Util::HoverTooltipWrapper()) {
+			ImGui::Text("Spreads the specular prefilter of each refresh over several frames.");
+		}
+		ImGui::SliderFloat("Prefilter Budget", &settings.PrefilterBudget, 0.05f, 2.0f, "%.2f ms");
+		if (auto _tt = Util::HoverTooltipWrapper()) {
+			ImGui::Text("GPU time per frame spent on the specular prefilter when time slicing. At least one face is filtered each frame.");
+		}
+
+		ImGui::Checkbox("Change Detection", (bool*)&settings.EnableChangeDetection);
+		if (auto _tt = Util::HoverTooltipWrapper()) {
+			ImGui::Text("Only refreshes the cubemap once the camera, view direction, sun or ambient lighting has changed noticeably.");
+		}
+		if (settings.EnableChangeDetection) {
+			ImGui::SliderFloat("Camera Threshold", &settings.CameraThreshold, 0.0f, 512.0f, "%.0f units");
+			ImGui::SliderFloat("View Threshold", &settings.ViewThreshold, 0.0f, 0.5f, "%.3f");
+			ImGui::SliderFloat("Sun Threshold", &settings.SunThreshold, 0.0f, 0.1f, "%.3f");
+			ImGui::SliderFloat("Color Threshold", &settings.ColorThreshold, 0.0f, 0.1f, "%.3f");
+			ImGui::Checkbox("Force Refresh", &forceRefresh);
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text("Refreshes continuously regardless of change detection, for comparison.");
+			}
+		}
+
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNodeEx("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
+		ImGui::Text(std::format("Frames Per Refresh : {}", framesPerRefresh).c_str());
+		ImGui::Text(std::format("Refreshes : {} executed, {} skipped", refreshesExecuted, refreshesSkipped).c_str());
+		ImGui::Text(std::format("Prefilter : {:.3f} ms last measured, {:.4f} ms per group", prefilterMilliseconds, prefilterMillisecondsPerGroup).c_str());
 		ImGui::TreePop();
 	}
 }
@@ -286,16 +327,87 @@ void DynamicCubemaps::DrawDeferred()
 	auto accumulator = RE::BSGraphics::BSShaderAccumulator::GetCurrentAccumulator();
 
 	if (shadowSceneNode == accumulator->GetRuntimeData().activeShadowSceneNode) {
-		if (nextTask == NextTask::kCapture) {
+		// A cell change abandons any refresh in progress and completes the next one in a single frame
+		if (nextTask == NextTask::kCapture || resetCapture) {
+			// A reset capture only clears the textures, so it is never taken as the reference environment
+			if (resetCapture) {
+				capturesUntilConverged = ConvergenceCaptures;
+			} else {
+				auto environment = GetEnvironmentState();
+				if (HasEnvironmentChanged(environment)) {
+					refreshEnvironment = environment;
+					capturesUntilConverged = ConvergenceCaptures;
+				} else if (capturesUntilConverged == 0) {
+					refreshesSkipped++;
+					return;
+				}
+				capturesUntilConverged--;
+			}
+			refreshesExecuted++;
+
+			fullRefresh = resetCapture || !settings.EnableTimeSlicing;
+			refreshStartFrame = RE::BSGraphics::State::GetSingleton()->uiFrameCount;
 			UpdateCubemapCapture();
 			nextTask = NextTask::kInferrence;
 		}
 	}
 }
 
+DynamicCubemaps::EnvironmentState DynamicCubemaps::GetEnvironmentState()
+{
+	EnvironmentState environment{};
+
+	auto& state = State::GetSingleton()->shadowState;
+	auto eyePosition = !REL::Module::IsVR() ?
+	                       state->GetRuntimeData().posAdjust.getEye(0) :
+	                       state->GetVRRuntimeData().posAdjust.getEye(0);
+	environment.eyePosition = { eyePosition.x, eyePosition.y, eyePosition.z };
+
+	// Third column of the view matrix: the view axis in world space
+	Matrix viewMatrix = !REL::Module::IsVR() ?
+	                        state->GetRuntimeData().cameraData.getEye(0).viewMat :
+	                        state->GetVRRuntimeData().cameraData.getEye(0).viewMat;
+	environment.viewDirection = { viewMatrix._13, viewMatrix._23, viewMatrix._33 };
+
+	auto accumulator = RE::BSGraphics::BSShaderAccumulator::GetCurrentAccumulator();
+	if (auto sunLight = skyrim_cast<RE::NiDirectionalLight*>(accumulator->GetRuntimeData().activeShadowSceneNode->GetRuntimeData().sunLight->light.get())) {
+		auto& direction = sunLight->GetWorldDirection();
+		environment.sunDirection = { direction.x, direction.y, direction.z };
+
+		auto& diffuse = sunLight->GetLightRuntimeData().diffuse;
+		environment.sunColor = float3(diffuse.red, diffuse.green, diffuse.blue) * sunLight->GetLightRuntimeData().fade;
+	}
+
+	// The directional ambient colours carry the sky's contribution
+	Util::StoreTransform3x4NoScale(environment.directionalAmbient, RE::BSShaderManager::State::GetSingleton().directionalAmbientTransform);
+
+	return environment;
+}
+
+bool DynamicCubemaps::HasEnvironmentChanged(const EnvironmentState& a_state) const
+{
+	if (forceRefresh || !settings.EnableChangeDetection)
+		return true;
+
+	if (float3::Distance(a_state.eyePosition, refreshEnvironment.eyePosition) > settings.CameraThreshold)
+		return true;
+
+	if (float3::Distance(a_state.viewDirection, refreshEnvironment.viewDirection) > settings.ViewThreshold)
+		return true;
+
+	if (float3::Distance(a_state.sunDirection, refreshEnvironment.sunDirection) > settings.SunThreshold)
+		return true;
+
+	float colorDelta = (a_state.sunColor - refreshEnvironment.sunColor).Length();
+	for (uint row = 0; row < 3; row++) {
+		for (uint column = 0; column < 4; column++)
+			colorDelta = std::max(colorDelta, std::abs(a_state.directionalAmbient.m[row][column] - refreshEnvironment.directionalAmbient.m[row][column]));
+	}
+	return colorDelta > settings.ColorThreshold;
+}
+
 void DynamicCubemaps::UpdateCubemap()
 {
-	auto renderer = RE::BSGraphics::Renderer::GetSingleton();
 	auto& context = State::GetSingleton()->context;
 
 	//if (!REL::Module::IsVR()) {
@@ -310,86 +422,180 @@ void DynamicCubemaps::UpdateCubemap()
 
 	if (nextTask == NextTask::kInferrence) {
 		nextTask = NextTask::kIrradiance;
+		InferCubemap();
+		if (!fullRefresh)
+			return;
+	}
 
-		// Infer local reflection information
-		ID3D11UnorderedAccessView* uav = envInferredTexture->uav.get();
+	if (nextTask == NextTask::kIrradiance) {
+		nextTask = NextTask::kPrefilter;
+		CopyAndGenerateMips();
+		prefilterItem = 0;
+	}
 
-		context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+	if (nextTask == NextTask::kPrefilter) {
+		ReadPrefilterTiming();
+		Prefilter(fullRefresh);
 
-		context->GenerateMips(envCaptureTexture->srv.get());
+		if (prefilterItem >= (MIPLEVELS - 1) * PrefilterFaceCount) {
+			nextTask = NextTask::kCapture;
+			framesPerRefresh = RE::BSGraphics::State::GetSingleton()->uiFrameCount - refreshStartFrame + 1;
+			fullRefresh = false;
+		}
+	}
+}
 
-		auto& cubemap = renderer->GetRendererData().cubemapRenderTargets[RE::RENDER_TARGETS_CUBEMAP::kREFLECTIONS];
+void DynamicCubemaps::InferCubemap()
+{
+	auto renderer = RE::BSGraphics::Renderer::GetSingleton();
+	auto& context = State::GetSingleton()->context;
 
-		ID3D11ShaderResourceView* srvs[2] = { envCaptureTexture->srv.get(), activeReflections ? cubemap.SRV : defaultCubemap };
-		context->CSSetShaderResources(0, 2, srvs);
+	// Infer local reflection information
+	ID3D11UnorderedAccessView* uav = envInferredTexture->uav.get();
 
-		context->CSSetSamplers(0, 1, &computeSampler);
+	context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
 
-		context->CSSetShader(activeReflections ? GetComputeShaderInferrenceReflections() : GetComputeShaderInferrence(), nullptr, 0);
+	context->GenerateMips(envCaptureTexture->srv.get());
 
-		context->Dispatch((uint32_t)std::ceil(envCaptureTexture->desc.Width / 32.0f), (uint32_t)std::ceil(envCaptureTexture->desc.Height / 32.0f), 6);
+	auto& cubemap = renderer->GetRendererData().cubemapRenderTargets[RE::RENDER_TARGETS_CUBEMAP::kREFLECTIONS];
 
-		srvs[0] = nullptr;
-		srvs[1] = nullptr;
-		context->CSSetShaderResources(0, 2, srvs);
+	ID3D11ShaderResourceView* srvs[2] = { envCaptureTexture->srv.get(), activeReflections ? cubemap.SRV : defaultCubemap };
+	context->CSSetShaderResources(0, 2, srvs);
 
-		uav = nullptr;
+	context->CSSetSamplers(0, 1, &computeSampler);
 
-		context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+	context->CSSetShader(activeReflections ? GetComputeShaderInferrenceReflections() : GetComputeShaderInferrence(), nullptr, 0);
 
-		context->CSSetShader(nullptr, 0, 0);
+	context->Dispatch((uint32_t)std::ceil(envCaptureTexture->desc.Width / 32.0f), (uint32_t)std::ceil(envCaptureTexture->desc.Height / 32.0f), 6);
 
-		ID3D11SamplerState* sampler = nullptr;
-		context->CSSetSamplers(0, 1, &sampler);
-	} else if (nextTask == NextTask::kIrradiance) {
-		nextTask = NextTask::kCapture;
+	srvs[0] = nullptr;
+	srvs[1] = nullptr;
+	context->CSSetShaderResources(0, 2, srvs);
 
-		// Copy cubemap to other resources
-		for (uint face = 0; face < 6; face++) {
-			uint srcSubresourceIndex = D3D11CalcSubresource(0, face, MIPLEVELS);
-			context->CopySubresourceRegion(envTexture->resource.get(), D3D11CalcSubresource(0, face, MIPLEVELS), 0, 0, 0, envInferredTexture->resource.get(), srcSubresourceIndex, nullptr);
-		}
+	uav = nullptr;
 
-		// Compute pre-filtered specular environment map.
-		{
-			auto srv = envInferredTexture->srv.get();
-			context->GenerateMips(srv);
+	context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
 
-			context->CSSetShaderResources(0, 1, &srv);
-			context->CSSetSamplers(0, 1, &computeSampler);
-			context->CSSetShader(GetComputeShaderSpecularIrradiance(), nullptr, 0);
+	context->CSSetShader(nullptr, 0, 0);
+
+	ID3D11SamplerState* sampler = nullptr;
+	context->CSSetSamplers(0, 1, &sampler);
+
+	BindingCache::GetSingleton()->InvalidateShaderResources();
+}
+
+void DynamicCubemaps::CopyAndGenerateMips()
+{
+	auto& context = State::GetSingleton()->context;
 
-			ID3D11Buffer* buffer = spmapCB->CB();
-			context->CSSetConstantBuffers(0, 1, &buffer);
+	// Copy cubemap to other resources
+	for (uint face = 0; face < 6; face++) {
+		uint srcSubresourceIndex = D3D11CalcSubresource(0, face, MIPLEVELS);
+		context->CopySubresourceRegion(envTexture->resource.get(), D3D11CalcSubresource(0, face, MIPLEVELS), 0, 0, 0, envInferredTexture->resource.get(), srcSubresourceIndex, nullptr);
+	}
 
-			float const delta_roughness = 1.0f / std::max(float(MIPLEVELS - 1), 1.0f);
+	context->GenerateMips(envInferredTexture->srv.get());
+}
 
-			std::uint32_t size = std::max(envTexture->desc.Width, envTexture->desc.Height);
+void DynamicCubemaps::Prefilter(bool a_unbounded)
+{
+	auto& context = State::GetSingleton()->context;
 
-			for (std::uint32_t level = 1; level < MIPLEVELS; level++, size /= 2) {
-				const UINT numGroups = (UINT)std::max(1u, size / 32);
+	// Compute pre-filtered specular environment map.
+	auto srv = envInferredTexture->srv.get();
+	context->CSSetShaderResources(0, 1, &srv);
+	context->CSSetSamplers(0, 1, &computeSampler);
+	context->CSSetShader(GetComputeShaderSpecularIrradiance(), nullptr, 0);
 
-				const SpecularMapFilterSettingsCB spmapConstants = { level * delta_roughness };
-				spmapCB->Update(spmapConstants);
+	ID3D11Buffer* buffer = spmapCB->CB();
+	context->CSSetConstantBuffers(0, 1, &buffer);
 
-				auto uav = uavArray[level - 1];
+	bool timed = !prefilterTimingPending;
+	if (timed) {
+		context->Begin(prefilterDisjointQuery.get());
+		context->End(prefilterTimestampQueries[0].get());
+	}
 
-				context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
-				context->Dispatch(numGroups, numGroups, 6);
-			}
+	float const delta_roughness = 1.0f / std::max(float(MIPLEVELS - 1), 1.0f);
+	const uint itemCount = (MIPLEVELS - 1) * PrefilterFaceCount;
+
+	double spent = 0.0;
+	uint64_t groupsDispatched = 0;
+	while (prefilterItem < itemCount) {
+		const uint level = 1 + prefilterItem / PrefilterFaceCount;
+		const uint face = prefilterItem % PrefilterFaceCount;
+		const uint size = std::max(std::max(envTexture->desc.Width, envTexture->desc.Height) >> level, 1u);
+		const uint numGroups = (size + 31) / 32;
+
+		// Filter the remaining faces of this level in one dispatch, or as many as fit in the budget
+		uint faceCount = PrefilterFaceCount - face;
+		if (!a_unbounded) {
+			double faceCost = numGroups * numGroups * prefilterMillisecondsPerGroup;
+			double remaining = std::max(settings.PrefilterBudget - spent, 0.0);
+			uint fit = faceCost > 0.0 ? (uint)std::min(remaining / faceCost, (double)faceCount) : faceCount;
+			if (fit == 0 && groupsDispatched > 0)
+				break;
+			faceCount = std::clamp(fit, 1u, faceCount);
+			spent += faceCount * faceCost;
 		}
 
-		ID3D11ShaderResourceView* nullSRV = { nullptr };
-		ID3D11SamplerState* nullSampler = { nullptr };
-		ID3D11Buffer* nullBuffer = { nullptr };
-		ID3D11UnorderedAccessView* nullUAV = { nullptr };
+		const SpecularMapFilterSettingsCB spmapConstants = { level * delta_roughness, face };
+		spmapCB->Update(spmapConstants);
+
+		auto uav = uavArray[level - 1];
+
+		context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+		context->Dispatch(numGroups, numGroups, faceCount);
+
+		prefilterItem += faceCount;
+		groupsDispatched += numGroups * numGroups * faceCount;
+	}
+
+	if (timed) {
+		context->End(prefilterTimestampQueries[1].get());
+		context->End(prefilterDisjointQuery.get());
+		prefilterTimedGroups = groupsDispatched;
+		prefilterTimingPending = true;
+	}
+
+	ID3D11ShaderResourceView* nullSRV = { nullptr };
+	ID3D11SamplerState* nullSampler = { nullptr };
+	ID3D11Buffer* nullBuffer = { nullptr };
+	ID3D11UnorderedAccessView* nullUAV = { nullptr };
+
+	context->CSSetShaderResources(0, 1, &nullSRV);
+	context->CSSetSamplers(0, 1, &nullSampler);
+	context->CSSetShader(nullptr, 0, 0);
+	context->CSSetConstantBuffers(0, 1, &nullBuffer);
+	context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+	BindingCache::GetSingleton()->InvalidateShaderResources();
+}
+
+void DynamicCubemaps::ReadPrefilterTiming()
+{
+	if (!prefilterTimingPending)
+		return;
+
+	auto& context = State::GetSingleton()->context;
+
+	// Results from an earlier frame; try again next frame if the GPU has not got there yet
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if (context->GetData(prefilterDisjointQuery.get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return;
 
-		context->CSSetShaderResources(0, 1, &nullSRV);
-		context->CSSetSamplers(0, 1, &nullSampler);
-		context->CSSetShader(nullptr, 0, 0);
-		context->CSSetConstantBuffers(0, 1, &nullBuffer);
-		context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+	uint64_t timestamps[2];
+	for (uint i = 0; i < 2; i++) {
+		if (context->GetData(prefilterTimestampQueries[i].get(), &timestamps[i], sizeof(uint64_t), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			return;
 	}
+
+	prefilterTimingPending = false;
+	if (disjoint.Disjoint || !disjoint.Frequency || !prefilterTimedGroups)
+		return;
+
+	prefilterMilliseconds = double(timestamps[1] - timestamps[0]) * 1000.0 / double(disjoint.Frequency);
+	double perGroup = prefilterMilliseconds / double(prefilterTimedGroups);
+	prefilterMillisecondsPerGroup = prefilterMillisecondsPerGroup > 0.0 ? std::lerp(prefilterMillisecondsPerGroup, perGroup, 0.25) : perGroup;
 }
 
 void DynamicCubemaps::Draw(const RE::BSShader* shader, const uint32_t)
@@ -424,6 +630,17 @@ void DynamicCubemaps::Draw(const RE::BSShader* shader, const uint32_t)
 	}
 }
 
+bool DynamicCubemaps::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Lighting:
+	case RE::BSShader::Type::Water:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void DynamicCubemaps::SetupResources()
 {
 	GetComputeShaderUpdate();
@@ -536,6 +753,16 @@ void DynamicCubemaps::SetupResources()
 	{
 		DirectX::CreateDDSTextureFromFile(device, L"Data\\Shaders\\DynamicCubemaps\\defaultcubemap.dds", nullptr, &defaultCubemap);
 	}
+
+	{
+		D3D11_QUERY_DESC queryDesc{};
+		queryDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		DX::ThrowIfFailed(device->CreateQuery(&queryDesc, prefilterDisjointQuery.put()));
+
+		queryDesc.Query = D3D11_QUERY_TIMESTAMP;
+		for (auto& query : prefilterTimestampQueries)
+			DX::ThrowIfFailed(device->CreateQuery(&queryDesc, query.put()));
+	}
 }
 
 void DynamicCubemaps::Reset()
@@ -553,13 +780,18 @@ void DynamicCubemaps::Reset()
 
 void DynamicCubemaps::Load(json& o_json)
 {
+	if (o_json[GetName()].is_object())
+		settings = o_json[GetName()];
+
 	Feature::Load(o_json);
 }
 
-void DynamicCubemaps::Save(json&)
+void DynamicCubemaps::Save(json& o_json)
 {
+	o_json[GetName()] = settings;
 }
 
 void DynamicCubemaps::RestoreDefaultSettings()
 {
+	settings = {};
 }
\ No newline at end of file
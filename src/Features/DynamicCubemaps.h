@@ -29,7 +29,8 @@ public:
 	struct alignas(16) SpecularMapFilterSettingsCB
 	{
 		float roughness;
-		float pad[3];
+		uint faceOffset;
+		float pad[2];
 	};
 
 	ID3D11ComputeShader* specularIrradianceCS = nullptr;
@@ -66,11 +67,67 @@ public:
 	{
 		kCapture,
 		kInferrence,
-		kIrradiance
+		kIrradiance,
+		kPrefilter
 	};
 
 	NextTask nextTask = NextTask::kCapture;
 
+	// Refresh scheduling
+
+	struct Settings
+	{
+		uint EnableTimeSlicing = true;
+		float PrefilterBudget = 0.25f;  // GPU milliseconds per frame
+		uint EnableChangeDetection = false;
+		float CameraThreshold = 32.0f;  // game units
+		float ViewThreshold = 0.05f;    // distance between unit view directions
+		float SunThreshold = 0.01f;     // distance between unit sun directions
+		float ColorThreshold = 0.01f;
+	};
+
+	Settings settings;
+
+	// The specular prefilter is split into one item per mip level and face, and each frame dispatches as
+	// many items as the GPU budget allows. The cost per thread group is measured with timestamp queries
+	// that are read back without waiting. A cell change forces the whole refresh into one frame.
+	static constexpr uint PrefilterFaceCount = 6;
+
+	uint prefilterItem = 0;
+	bool fullRefresh = true;
+	uint32_t refreshStartFrame = 0;
+	uint32_t framesPerRefresh = 0;
+
+	winrt::com_ptr<ID3D11Query> prefilterDisjointQuery;
+	winrt::com_ptr<ID3D11Query> prefilterTimestampQueries[2];
+	bool prefilterTimingPending = false;
+	uint64_t prefilterTimedGroups = 0;
+	double prefilterMillisecondsPerGroup = 0.0;
+	double prefilterMilliseconds = 0.0;
+
+	// Change detection
+
+	// Inputs to the cubemap that are cheap to read on the CPU. A new refresh only starts once one of them
+	// has moved past its threshold since the last refresh; otherwise the filtered envTexture is reused.
+	// The capture blends each new frame in by half, so after a change or a reset it keeps refreshing until
+	// the accumulation has converged.
+	static constexpr uint ConvergenceCaptures = 8;
+
+	struct EnvironmentState
+	{
+		float3 eyePosition;
+		float3 viewDirection;
+		float3 sunDirection;
+		float3 sunColor;
+		DirectX::XMFLOAT3X4 directionalAmbient;
+	};
+
+	EnvironmentState refreshEnvironment{};
+	uint capturesUntilConverged = ConvergenceCaptures;
+	bool forceRefresh = false;
+	uint64_t refreshesExecuted = 0;
+	uint64_t refreshesSkipped = 0;
+
 	// Editor window
 
 	bool enableCreator = false;
@@ -86,6 +143,12 @@ public:
 	std::unique_ptr<Buffer> perFrameCreator = nullptr;
 
 	void UpdateCubemap();
+	void InferCubemap();
+	void CopyAndGenerateMips();
+	void Prefilter(bool a_unbounded);
+	void ReadPrefilterTiming();
+	EnvironmentState GetEnvironmentState();
+	bool HasEnvironmentChanged(const EnvironmentState& a_state) const;
 
 	virtual inline std::string GetName() { return "Dynamic Cubemaps"; }
 	virtual inline std::string GetShortName() { return "DynamicCubemaps"; }
@@ -99,6 +162,8 @@ public:
 	virtual void DataLoaded() override;
 
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
+	bool HasDrawDeferred() override { return true; }
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
@@ -2,6 +2,7 @@
 
 #include "Buffer.h"
 #include "Feature.h"
+#include "FrameConstants.h"
 #include "State.h"
 
 struct ExtendedMaterials : Feature
@@ -43,7 +44,7 @@ struct ExtendedMaterials : Feature
 
 	Settings settings;
 
-	std::unique_ptr<Buffer> perPass = nullptr;
+	FrameConstants::TypedBlock<PerPass> perPass;
 
 	ID3D11SamplerState* terrainSampler = nullptr;
 
@@ -56,6 +57,7 @@ struct ExtendedMaterials : Feature
 
 	void ModifyLighting(const RE::BSShader* shader, const uint32_t descriptor);
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
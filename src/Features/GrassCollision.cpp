@@ -1,6 +1,7 @@
 #include "GrassCollision.h"
 
 #include "State.h"
+#include "BindingCache.h"
 #include "Util.h"
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
@@ -51,6 +52,16 @@ void GrassCollision::DrawSettings()
 	if (ImGui::TreeNodeEx("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
 		ImGui::Text(std::format("Active/Total Actors : {}/{}", activeActorCount, totalActorCount).c_str());
 		ImGui::Text(std::format("Total Collisions : {}", currentCollisionCount).c_str());
+		ImGui::Text(std::format("Collision Grid : {} binned entries, at most {} per cell", binnedCollisions.size(), maxCellCollisions).c_str());
+		ImGui::Text(std::format("Update Time : {:.3f} ms ({:.3f} ms extracting on {} threads)", updateMilliseconds, extractMilliseconds, extractThreadCount).c_str());
+		ImGui::Text(std::format("Collision Buffer : {} capacity, {} reallocations", collisionCapacity, collisionBufferReallocations).c_str());
+
+		if (State::GetSingleton()->IsDeveloperMode()) {
+			ImGui::SliderInt("Extract Threads", (int*)&extractThreadCount, 1, 16);
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text("Threads used to extract actor collision bodies, including the render thread. ");
+			}
+		}
 		ImGui::TreePop();
 	}
 }
@@ -96,7 +107,7 @@ static bool GetShapeBound(RE::NiAVObject* a_node, RE::NiPoint3& centerPos, float
 	return false;
 }
 
-static bool GetShapeBound(RE::bhkNiCollisionObject* Colliedobj, RE::NiPoint3& centerPos, float& radius)
+bool GrassCollision::GetShapeBound(RE::bhkNiCollisionObject* Colliedobj, RE::NiPoint3& centerPos, float& radius, ExtractScratch& a_scratch)
 {
 	if (!Colliedobj)
 		return false;
@@ -112,6 +123,13 @@ static bool GetShapeBound(RE::bhkNiCollisionObject* Colliedobj, RE::NiPoint3& ce
 
 		const RE::hkpShape* shape = hkpRigid->collidable.GetShape();
 		if (shape) {
+			auto it = shapeExtents.find(Colliedobj);
+			if (it != shapeExtents.end() && it->second.shape == shape) {
+				it->second.lastUsed = shapeExtentFrame;
+				radius = it->second.radius;
+				return true;
+			}
+
 			float upExtent = shape->GetMaximumProjection(RE::hkVector4{ 0.0f, 0.0f, 1.0f, 0.0f }) * RE::bhkWorld::GetWorldScaleInverse();
 			float downExtent = shape->GetMaximumProjection(RE::hkVector4{ 0.0f, 0.0f, -1.0f, 0.0f }) * RE::bhkWorld::GetWorldScaleInverse();
 			auto z_extent = (upExtent + downExtent) / 2.0f;
@@ -126,6 +144,13 @@ static bool GetShapeBound(RE::bhkNiCollisionObject* Colliedobj, RE::NiPoint3& ce
 
 			radius = sqrtf(x_extent * x_extent + y_extent * y_extent + z_extent * z_extent);
 
+			// Each body belongs to one actor, so its existing entry is only touched by one worker
+			ShapeExtent extent{ shape, radius, shapeExtentFrame };
+			if (it != shapeExtents.end())
+				it->second = extent;
+			else
+				a_scratch.newExtents.emplace_back(Colliedobj, extent);
+
 			return true;
 		}
 	}
@@ -133,6 +158,30 @@ static bool GetShapeBound(RE::bhkNiCollisionObject* Colliedobj, RE::NiPoint3& ce
 	return false;
 }
 
+void GrassCollision::ExtractActorCollisions(RE::Actor* a_actor, const RE::NiPoint3* a_eyePositions, ExtractScratch& a_scratch)
+{
+	auto root = a_actor->Get3D(false);
+	if (!root)
+		return;
+
+	RE::BSVisit::TraverseScenegraphCollision(root, [&](RE::bhkNiCollisionObject* a_object) -> RE::BSVisit::BSVisitControl {
+		RE::NiPoint3 centerPos;
+		float radius;
+		if (GetShapeBound(a_object, centerPos, radius, a_scratch)) {
+			radius *= settings.RadiusMultiplier;
+			CollisionSData data{};
+			for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++) {
+				data.centre[eyeIndex].x = centerPos.x - a_eyePositions[eyeIndex].x;
+				data.centre[eyeIndex].y = centerPos.y - a_eyePositions[eyeIndex].y;
+				data.centre[eyeIndex].z = centerPos.z - a_eyePositions[eyeIndex].z;
+			}
+			data.radius = radius;
+			a_scratch.collisions.push_back(data);
+		}
+		return RE::BSVisit::BSVisitControl::kContinue;
+	});
+}
+
 void GrassCollision::UpdateCollisions()
 {
 	auto& state = State::GetSingleton()->shadowState;
@@ -140,24 +189,30 @@ void GrassCollision::UpdateCollisions()
 	auto frameCount = RE::BSGraphics::State::GetSingleton()->uiFrameCount;
 
 	if (settings.frameInterval == 0 || frameCount % settings.frameInterval == 0) {  // only calculate actor positions on some frames
+		auto start = std::chrono::high_resolution_clock::now();
+
 		currentCollisionCount = 0;
 		totalActorCount = 0;
 		activeActorCount = 0;
 		actorList.clear();
 		collisionsData.clear();
-		// actor query code from po3 under MIT
-		// https://github.com/powerof3/PapyrusExtenderSSE/blob/7a73b47bc87331bec4e16f5f42f2dbc98b66c3a7/include/Papyrus/Functions/Faction.h#L24C7-L46
-		if (const auto processLists = RE::ProcessLists::GetSingleton(); processLists && settings.maxDistance > 0.0f) {
-			std::vector<RE::BSTArray<RE::ActorHandle>*> actors;
-			actors.push_back(&processLists->highActorHandles);  // high actors are in combat or doing something interesting
-			for (auto array : actors) {
-				for (auto& actorHandle : *array) {
-					auto actorPtr = actorHandle.get();
-					if (actorPtr && actorPtr.get() && actorPtr.get()->Is3DLoaded()) {
-						actorList.push_back(actorPtr.get());
-						totalActorCount++;
-					}
+		shapeExtentFrame++;
+
+		if (settings.maxDistance > 0.0f) {
+			std::lock_guard lock{ trackedActorsMutex };
+			for (auto it = trackedActors.begin(); it != trackedActors.end();) {
+				auto actorPtr = it->second.get();
+				if (!actorPtr) {
+					it = trackedActors.erase(it);
+					continue;
+				}
+				// as with ProcessLists::highActorHandles, only actors in high process are doing something worth colliding with
+				auto process = actorPtr->GetActorRuntimeData().currentProcess;
+				if (actorPtr->Is3DLoaded() && process && process->InHighProcess()) {
+					actorList.push_back(actorPtr.get());
+					totalActorCount++;
 				}
+				++it;
 			}
 		}
 
@@ -167,48 +222,93 @@ void GrassCollision::UpdateCollisions()
 			playerPosition = player->GetPosition();
 		}
 
-		for (const auto actor : actorList) {
-			if (auto root = actor->Get3D(false)) {
-				if (playerPosition.GetDistance(actor->GetPosition()) > settings.maxDistance) {  // npc too far so skip
-					continue;
-				}
-				activeActorCount++;
-				RE::BSVisit::TraverseScenegraphCollision(root, [&](RE::bhkNiCollisionObject* a_object) -> RE::BSVisit::BSVisitControl {
-					RE::NiPoint3 centerPos;
-					float radius;
-					if (GetShapeBound(a_object, centerPos, radius)) {
-						radius *= settings.RadiusMultiplier;
-						CollisionSData data{};
-						RE::NiPoint3 eyePosition{};
-						for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++) {
-							if (!REL::Module::IsVR()) {
-								eyePosition = state->GetRuntimeData().posAdjust.getEye();
-							} else
-								eyePosition = state->GetVRRuntimeData().posAdjust.getEye(eyeIndex);
-							data.centre[eyeIndex].x = centerPos.x - eyePosition.x;
-							data.centre[eyeIndex].y = centerPos.y - eyePosition.y;
-							data.centre[eyeIndex].z = centerPos.z - eyePosition.z;
-						}
-						data.radius = radius;
-						currentCollisionCount++;
-						collisionsData.push_back(data);
-					}
-					return RE::BSVisit::BSVisitControl::kContinue;
-				});
+		RE::NiPoint3 eyePositions[2]{};
+		for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++) {
+			if (!REL::Module::IsVR()) {
+				eyePositions[eyeIndex] = state->GetRuntimeData().posAdjust.getEye();
+			} else
+				eyePositions[eyeIndex] = state->GetVRRuntimeData().posAdjust.getEye(eyeIndex);
+		}
+
+		// Distance culling is cheap and stays on the render thread; only the scene graph walk is spread out
+		std::erase_if(actorList, [&](RE::Actor* a_actor) { return playerPosition.GetDistance(a_actor->GetPosition()) > settings.maxDistance; });
+
+		auto extractStart = std::chrono::high_resolution_clock::now();
+
+		const std::uint32_t threadCount = std::clamp(extractThreadCount, 1u, 16u);
+		if (extractScratch.size() < threadCount)
+			extractScratch.resize(threadCount);
+		for (auto& scratch : extractScratch) {
+			scratch.collisions.clear();
+			scratch.newExtents.clear();
+		}
+		actorRanges.assign(actorList.size(), {});
+
+		std::atomic<std::uint32_t> nextActor = 0;
+		auto extract = [&](std::uint32_t a_scratchIndex) {
+			auto& scratch = extractScratch[a_scratchIndex];
+			for (std::uint32_t i = nextActor++; i < actorList.size(); i = nextActor++) {
+				auto offset = (std::uint32_t)scratch.collisions.size();
+				ExtractActorCollisions(actorList[i], eyePositions, scratch);
+				actorRanges[i] = { a_scratchIndex, offset, (std::uint32_t)scratch.collisions.size() - offset };
 			}
+		};
+
+		if (threadCount > 1 && actorList.size() > 1) {
+			if (extractPool.get_thread_count() != threadCount - 1)
+				extractPool.reset(threadCount - 1);
+			for (std::uint32_t t = 1; t < threadCount; t++)
+				extractPool.push_task([&extract, t] { extract(t); });
+			extract(0);
+			extractPool.wait_for_tasks();
+		} else {
+			extract(0);
 		}
-	}
-	if (!currentCollisionCount) {
-		CollisionSData data{};
-		ZeroMemory(&data, sizeof(data));
-		collisionsData.push_back(data);
-		currentCollisionCount = 1;
+
+		// Merge in actor order
+
+		for (const auto& range : actorRanges) {
+			if (range.count) {
+				auto& scratch = extractScratch[range.scratch].collisions;
+				collisionsData.insert(collisionsData.end(), scratch.begin() + range.offset, scratch.begin() + range.offset + range.count);
+			}
+		}
+		for (auto& scratch : extractScratch) {
+			for (const auto& [object, extent] : scratch.newExtents)
+				shapeExtents.insert_or_assign(object, extent);
+		}
+
+		activeActorCount = (std::uint32_t)actorList.size();
+		currentCollisionCount = (std::uint32_t)collisionsData.size();
+		extractMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - extractStart).count();
+
+		// The grid is centred on the first eye; other eyes see it offset by the distance between eyes
+		const float halfExtent = GridSize * GridCellSize * 0.5f;
+		for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++) {
+			gridOrigin[eyeIndex].x = eyePositions[0].x - halfExtent - eyePositions[eyeIndex].x;
+			gridOrigin[eyeIndex].y = eyePositions[0].y - halfExtent - eyePositions[eyeIndex].y;
+		}
+
+		BinCollisions();
+
+		// Forget extents of bodies that have not been seen for a while
+		for (auto it = shapeExtents.begin(); it != shapeExtents.end();) {
+			if (shapeExtentFrame - it->second.lastUsed > 300)
+				it = shapeExtents.erase(it);
+			else
+				++it;
+		}
+
+		updateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 	}
 
-	bool collisionCountChanged = currentCollisionCount != colllisionCount;
+	if (binnedCollisions.empty())
+		binnedCollisions.push_back({});  // keeps the buffer valid; no cell references it
 
-	if (!collisions || collisionCountChanged) {
-		colllisionCount = currentCollisionCount;
+	if (!collisions || binnedCollisions.size() > collisionCapacity) {
+		collisionCapacity = std::max(std::bit_ceil((std::uint32_t)binnedCollisions.size()), 64u);
+		if (collisions)
+			collisionBufferReallocations++;
 
 		D3D11_BUFFER_DESC sbDesc{};
 		sbDesc.Usage = D3D11_USAGE_DYNAMIC;
@@ -216,23 +316,85 @@ void GrassCollision::UpdateCollisions()
 		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 		sbDesc.StructureByteStride = sizeof(CollisionSData);
-		sbDesc.ByteWidth = sizeof(CollisionSData) * colllisionCount;
+		sbDesc.ByteWidth = sizeof(CollisionSData) * collisionCapacity;
 		collisions = std::make_unique<Buffer>(sbDesc);
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
 		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
 		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
 		srvDesc.Buffer.FirstElement = 0;
-		srvDesc.Buffer.NumElements = colllisionCount;
+		srvDesc.Buffer.NumElements = collisionCapacity;
 		collisions->CreateSRV(srvDesc);
 	}
 
 	auto& context = State::GetSingleton()->context;
 	D3D11_MAPPED_SUBRESOURCE mapped;
 	DX::ThrowIfFailed(context->Map(collisions->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-	size_t bytes = sizeof(CollisionSData) * colllisionCount;
-	memcpy_s(mapped.pData, bytes, collisionsData.data(), bytes);
+	size_t bytes = sizeof(CollisionSData) * binnedCollisions.size();
+	memcpy_s(mapped.pData, bytes, binnedCollisions.data(), bytes);
 	context->Unmap(collisions->resource.get(), 0);
+
+	DX::ThrowIfFailed(context->Map(collisionGrid->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	bytes = sizeof(collisionCells);
+	memcpy_s(mapped.pData, bytes, collisionCells.data(), bytes);
+	context->Unmap(collisionGrid->resource.get(), 0);
+}
+
+void GrassCollision::BinCollisions()
+{
+	struct CellRange
+	{
+		std::uint32_t minX, minY, maxX, maxY;
+	};
+
+	// Cells touched by the collider's footprint, or false if it lies entirely outside the grid
+	auto getCellRange = [&](const CollisionSData& a_collision, CellRange& o_range) {
+		float minX = std::floor((a_collision.centre[0].x - a_collision.radius - gridOrigin[0].x) / GridCellSize);
+		float minY = std::floor((a_collision.centre[0].y - a_collision.radius - gridOrigin[0].y) / GridCellSize);
+		float maxX = std::floor((a_collision.centre[0].x + a_collision.radius - gridOrigin[0].x) / GridCellSize);
+		float maxY = std::floor((a_collision.centre[0].y + a_collision.radius - gridOrigin[0].y) / GridCellSize);
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)GridSize || minY >= (float)GridSize)
+			return false;
+
+		o_range.minX = (std::uint32_t)std::max(minX, 0.0f);
+		o_range.minY = (std::uint32_t)std::max(minY, 0.0f);
+		o_range.maxX = (std::uint32_t)std::min(maxX, (float)GridSize - 1.0f);
+		o_range.maxY = (std::uint32_t)std::min(maxY, (float)GridSize - 1.0f);
+		return true;
+	};
+
+	// Count colliders per cell, lay the cells out, then fill them in collider order
+
+	collisionCells = {};
+	CellRange range{};
+	for (const auto& collision : collisionsData) {
+		if (!getCellRange(collision, range))
+			continue;
+		for (std::uint32_t y = range.minY; y <= range.maxY; y++)
+			for (std::uint32_t x = range.minX; x <= range.maxX; x++)
+				collisionCells[x + y * GridSize].count++;
+	}
+
+	std::uint32_t offset = 0;
+	maxCellCollisions = 0;
+	for (auto& cell : collisionCells) {
+		cell.offset = offset;
+		offset += cell.count;
+		maxCellCollisions = std::max(maxCellCollisions, cell.count);
+		cell.count = 0;
+	}
+
+	binnedCollisions.resize(offset);
+	for (const auto& collision : collisionsData) {
+		if (!getCellRange(collision, range))
+			continue;
+		for (std::uint32_t y = range.minY; y <= range.maxY; y++) {
+			for (std::uint32_t x = range.minX; x <= range.maxX; x++) {
+				auto& cell = collisionCells[x + y * GridSize];
+				binnedCollisions[cell.offset + cell.count++] = collision;
+			}
+		}
+	}
 }
 
 void GrassCollision::ModifyGrass(const RE::BSShader*, const uint32_t)
@@ -265,6 +427,9 @@ void GrassCollision::ModifyGrass(const RE::BSShader*, const uint32_t)
 		}
 		perFrameData.boundRadius = bound.radius * settings.RadiusMultiplier;
 
+		for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++)
+			perFrameData.gridOrigin[eyeIndex] = { gridOrigin[eyeIndex].x, gridOrigin[eyeIndex].y, 0.0f, 0.0f };
+
 		perFrameData.Settings = settings;
 
 		perFrame->Update(perFrameData);
@@ -273,15 +438,16 @@ void GrassCollision::ModifyGrass(const RE::BSShader*, const uint32_t)
 	}
 
 	if (settings.EnableGrassCollision) {
-		auto& context = State::GetSingleton()->context;
+		auto bindingCache = BindingCache::GetSingleton();
 
-		ID3D11ShaderResourceView* views[1]{};
+		ID3D11ShaderResourceView* views[2]{};
 		views[0] = collisions->srv.get();
-		context->VSSetShaderResources(0, ARRAYSIZE(views), views);
+		views[1] = collisionGrid->srv.get();
+		bindingCache->SetShaderResources(BindingCache::Stage::Vertex, 0, ARRAYSIZE(views), views);
 
 		ID3D11Buffer* buffers[1];
 		buffers[0] = perFrame->CB();
-		context->VSSetConstantBuffers(5, ARRAYSIZE(buffers), buffers);
+		bindingCache->SetConstantBuffers(BindingCache::Stage::Vertex, 5, ARRAYSIZE(buffers), buffers);
 	}
 }
 
@@ -294,6 +460,16 @@ void GrassCollision::Draw(const RE::BSShader* shader, const uint32_t descriptor)
 	}
 }
 
+bool GrassCollision::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Grass:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void GrassCollision::Load(json& o_json)
 {
 	if (o_json[GetName()].is_object())
@@ -312,9 +488,59 @@ void GrassCollision::RestoreDefaultSettings()
 	settings = {};
 }
 
+void GrassCollision::DataLoaded()
+{
+	ActorLoadEventHandler::Register();
+}
+
+RE::BSEventNotifyControl ActorLoadEventHandler::ProcessEvent(const RE::TESObjectLoadedEvent* a_event, RE::BSTEventSource<RE::TESObjectLoadedEvent>*)
+{
+	// The player is always collected separately
+	if (!a_event || a_event->formID == 0x14)
+		return RE::BSEventNotifyControl::kContinue;
+
+	auto grassCollision = GrassCollision::GetSingleton();
+	if (a_event->loaded) {
+		if (auto actor = RE::TESForm::LookupByID<RE::Actor>(a_event->formID)) {
+			std::lock_guard lock{ grassCollision->trackedActorsMutex };
+			grassCollision->trackedActors.insert_or_assign(a_event->formID, actor->GetHandle());
+		}
+	} else {
+		std::lock_guard lock{ grassCollision->trackedActorsMutex };
+		grassCollision->trackedActors.erase(a_event->formID);
+	}
+	return RE::BSEventNotifyControl::kContinue;
+}
+
+bool ActorLoadEventHandler::Register()
+{
+	static ActorLoadEventHandler singleton;
+	auto scriptEventSource = RE::ScriptEventSourceHolder::GetSingleton();
+
+	if (!scriptEventSource) {
+		logger::error("Script event source not found");
+		return false;
+	}
+
+	scriptEventSource->AddEventSink<RE::TESObjectLoadedEvent>(&singleton);
+
+	logger::info("Registered {}", typeid(singleton).name());
+
+	return true;
+}
+
 void GrassCollision::SetupResources()
 {
 	perFrame = new ConstantBuffer(ConstantBufferDesc<PerFrame>());
+
+	collisionGrid = std::make_unique<Buffer>(StructuredBufferDesc<CollisionCell>(GridSize * GridSize, false, true));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = GridSize * GridSize;
+	collisionGrid->CreateSRV(srvDesc);
 }
 
 void GrassCollision::Reset()
@@ -1,8 +1,17 @@
 #pragma once
 
+#include "BS_thread_pool.hpp"
+
 #include "Buffer.h"
 #include "Feature.h"
 
+class ActorLoadEventHandler : public RE::BSTEventSink<RE::TESObjectLoadedEvent>
+{
+public:
+	virtual RE::BSEventNotifyControl ProcessEvent(const RE::TESObjectLoadedEvent* a_event, RE::BSTEventSource<RE::TESObjectLoadedEvent>* a_eventSource);
+	static bool Register();
+};
+
 struct GrassCollision : Feature
 {
 	static GrassCollision* GetSingleton()
@@ -32,6 +41,7 @@ struct GrassCollision : Feature
 		float boundRadius;
 		Settings Settings;
 		float pad01[2];
+		Vector4 gridOrigin[2];
 	};
 
 	struct CollisionSData
@@ -40,13 +50,68 @@ struct GrassCollision : Feature
 		float radius;
 	};
 
+	// Colliders are binned into a camera-relative 2D grid so each grass vertex only tests the colliders
+	// overlapping its own cell. Must match GrassCollision.hlsli.
+	static constexpr std::uint32_t GridSize = 32;
+	static constexpr float GridCellSize = 128.0f;
+
+	struct CollisionCell
+	{
+		std::uint32_t offset;
+		std::uint32_t count;
+	};
+
 	std::unique_ptr<Buffer> collisions = nullptr;
+	std::uint32_t collisionCapacity = 0;  // grows by doubling, never shrinks
+	std::uint32_t collisionBufferReallocations = 0;
+	std::unique_ptr<Buffer> collisionGrid = nullptr;
+	std::vector<CollisionSData> binnedCollisions{};
+	std::array<CollisionCell, GridSize * GridSize> collisionCells{};
+	Vector2 gridOrigin[2]{};
+	std::uint32_t maxCellCollisions = 0;
 	std::uint32_t totalActorCount = 0;
 	std::uint32_t activeActorCount = 0;
 	std::uint32_t currentCollisionCount = 0;
 	std::vector<RE::Actor*> actorList{};
 	std::vector<CollisionSData> collisionsData{};
-	std::uint32_t colllisionCount = 0;
+	double updateMilliseconds = 0.0;
+
+	// Actors with loaded 3D, maintained from load and unload events instead of rescanning the process lists;
+	// only those in high process are collected
+	std::mutex trackedActorsMutex;
+	ankerl::unordered_dense::map<RE::FormID, RE::ActorHandle> trackedActors;
+
+	// Shape extents in world units, only recomputed when a body's shape changes
+	struct ShapeExtent
+	{
+		const RE::hkpShape* shape;
+		float radius;
+		std::uint32_t lastUsed;
+	};
+	ankerl::unordered_dense::map<RE::bhkNiCollisionObject*, ShapeExtent> shapeExtents;
+	std::uint32_t shapeExtentFrame = 0;
+
+	// Actors are extracted as jobs. Each worker appends to its own scratch and records where each actor's
+	// colliders landed, and the ranges are merged in actor order so the result matches a serial walk.
+	// Workers only update existing shape extents; new ones are collected and inserted after the jobs finish.
+	struct ExtractScratch
+	{
+		std::vector<CollisionSData> collisions;
+		std::vector<std::pair<RE::bhkNiCollisionObject*, ShapeExtent>> newExtents;
+	};
+
+	struct ActorRange
+	{
+		std::uint32_t scratch;
+		std::uint32_t offset;
+		std::uint32_t count;
+	};
+
+	BS::thread_pool extractPool{ 1 };
+	std::uint32_t extractThreadCount = std::clamp(std::thread::hardware_concurrency() / 4, 1u, 4u);  // including the render thread
+	std::vector<ExtractScratch> extractScratch;
+	std::vector<ActorRange> actorRanges;
+	double extractMilliseconds = 0.0;
 
 	Settings settings;
 
@@ -56,11 +121,16 @@ struct GrassCollision : Feature
 
 	virtual void SetupResources();
 	virtual void Reset();
+	virtual void DataLoaded() override;
 
 	virtual void DrawSettings();
 	void UpdateCollisions();
+	void BinCollisions();
+	void ExtractActorCollisions(RE::Actor* a_actor, const RE::NiPoint3* a_eyePositions, ExtractScratch& a_scratch);
+	bool GetShapeBound(RE::bhkNiCollisionObject* a_object, RE::NiPoint3& centerPos, float& radius, ExtractScratch& a_scratch);
 	void ModifyGrass(const RE::BSShader* shader, const uint32_t descriptor);
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
@@ -119,6 +119,16 @@ void GrassLighting::Draw(const RE::BSShader* shader, const uint32_t descriptor)
 	}
 }
 
+bool GrassLighting::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Grass:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void GrassLighting::Load(json& o_json)
 {
 	if (o_json[GetName()].is_object())
@@ -42,6 +42,7 @@ struct GrassLighting : Feature
 	virtual void DrawSettings();
 	void ModifyGrass(const RE::BSShader* shader, const uint32_t descriptor);
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
@@ -0,0 +1,173 @@
+#include "ClusterReference.h"
+
+namespace ClusterReference
+{
+	using namespace DirectX;
+
+	static float3 GetPositionVS(float2 a_texcoord, float a_depth, const float4x4& a_invProjMatrix)
+	{
+		float4 clipSpaceLocation{ a_texcoord.x * 2.0f - 1.0f, -(a_texcoord.y * 2.0f - 1.0f), a_depth, 1.0f };
+		float4 homogenousLocation = float4::Transform(clipSpaceLocation, a_invProjMatrix);
+		return float3(homogenousLocation.x, homogenousLocation.y, homogenousLocation.z) / homogenousLocation.w;
+	}
+
+	static float3 IntersectionZPlane(float3 a_point, float a_zDistance)
+	{
+		return a_point * (a_zDistance / a_point.z);
+	}
+
+	void BuildClusters(const LightLimitFix::LightBuildingCB& a_cb, uint a_eyeCount, std::span<LightLimitFix::ClusterAABB> a_clusters)
+	{
+		const float2 clusterSize{ 1.0f / ClusterSizeX, 1.0f / ClusterSizeY };
+		const float depthRatio = a_cb.LightsFar / a_cb.LightsNear;
+
+		for (uint z = 0; z < ClusterSizeZ; z++) {
+			float clusterNear = a_cb.LightsNear * std::pow(depthRatio, z / float(ClusterSizeZ));
+			float clusterFar = a_cb.LightsNear * std::pow(depthRatio, (z + 1) / float(ClusterSizeZ));
+
+			for (uint y = 0; y < ClusterSizeY; y++) {
+				for (uint x = 0; x < ClusterSizeX; x++) {
+					float2 texcoordMax{ (x + 1) * clusterSize.x, (y + 1) * clusterSize.y };
+					float2 texcoordMin{ x * clusterSize.x, y * clusterSize.y };
+
+					float3 maxPointVS = GetPositionVS(texcoordMax, 1.0f, a_cb.InvProjMatrix[0]);
+					float3 minPointVS = GetPositionVS(texcoordMin, 1.0f, a_cb.InvProjMatrix[0]);
+					if (a_eyeCount == 2) {
+						maxPointVS = float3::Max(maxPointVS, GetPositionVS(texcoordMax, 1.0f, a_cb.InvProjMatrix[1]));
+						minPointVS = float3::Min(minPointVS, GetPositionVS(texcoordMin, 1.0f, a_cb.InvProjMatrix[1]));
+					}
+
+					float3 minPointNear = IntersectionZPlane(minPointVS, clusterNear);
+					float3 minPointFar = IntersectionZPlane(minPointVS, clusterFar);
+					float3 maxPointNear = IntersectionZPlane(maxPointVS, clusterNear);
+					float3 maxPointFar = IntersectionZPlane(maxPointVS, clusterFar);
+
+					float3 minPointAABB = float3::Min(float3::Min(minPointNear, minPointFar), float3::Min(maxPointNear, maxPointFar));
+					float3 maxPointAABB = float3::Max(float3::Max(minPointNear, minPointFar), float3::Max(maxPointNear, maxPointFar));
+
+					auto& cluster = a_clusters[x + y * ClusterSizeX + z * (ClusterSizeX * ClusterSizeY)];
+					cluster.minPoint = float4(minPointAABB.x, minPointAABB.y, minPointAABB.z, 0.0f);
+					cluster.maxPoint = float4(maxPointAABB.x, maxPointAABB.y, maxPointAABB.z, 0.0f);
+				}
+			}
+		}
+	}
+
+	static bool LightIntersectsCluster(FXMVECTOR a_positionVS, float a_radius, FXMVECTOR a_minPoint, FXMVECTOR a_maxPoint)
+	{
+		XMVECTOR closest = XMVectorMax(a_minPoint, XMVectorMin(a_positionVS, a_maxPoint));
+		XMVECTOR dist = XMVectorSubtract(closest, a_positionVS);
+		return XMVectorGetX(XMVector3Dot(dist, dist)) <= a_radius * a_radius;
+	}
+
+	uint CullLights(std::span<const LightLimitFix::ClusterAABB> a_clusters, std::span<const LightLimitFix::LightData> a_lights, uint a_eyeCount,
+		std::span<LightLimitFix::LightGrid> a_lightGrid, std::span<uint> a_lightList)
+	{
+		uint offset = 0;
+		for (uint clusterIndex = 0; clusterIndex < ClusterCount; clusterIndex++) {
+			const auto& cluster = a_clusters[clusterIndex];
+			XMVECTOR minPoint = XMLoadFloat4(&cluster.minPoint);
+			XMVECTOR maxPoint = XMLoadFloat4(&cluster.maxPoint);
+
+			uint visibleLightCount = 0;
+			for (uint i = 0; i < a_lights.size() && visibleLightCount < MaxClusterLights; i++) {
+				const auto& light = a_lights[i];
+				bool visible = LightIntersectsCluster(XMLoadFloat3(&light.positionVS[0].data), light.radius, minPoint, maxPoint);
+				if (!visible && a_eyeCount == 2)
+					visible = LightIntersectsCluster(XMLoadFloat3(&light.positionVS[1].data), light.radius, minPoint, maxPoint);
+				if (visible)
+					a_lightList[offset + visibleLightCount++] = i;
+			}
+
+			a_lightGrid[clusterIndex].offset = offset;
+			a_lightGrid[clusterIndex].lightCount = visibleLightCount;
+			offset += visibleLightCount;
+		}
+		return offset;
+	}
+
+	template <class T>
+	static std::vector<T> ReadBack(ID3D11DeviceContext* a_context, ID3D11Buffer* a_buffer)
+	{
+		D3D11_BUFFER_DESC desc;
+		a_buffer->GetDesc(&desc);
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+
+		winrt::com_ptr<ID3D11Device> device;
+		a_context->GetDevice(device.put());
+		winrt::com_ptr<ID3D11Buffer> staging;
+		DX::ThrowIfFailed(device->CreateBuffer(&desc, nullptr, staging.put()));
+		a_context->CopyResource(staging.get(), a_buffer);
+
+		std::vector<T> data(desc.ByteWidth / sizeof(T));
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		DX::ThrowIfFailed(a_context->Map(staging.get(), 0, D3D11_MAP_READ, 0, &mapped));
+		size_t bytes = data.size() * sizeof(T);
+		memcpy_s(data.data(), bytes, mapped.pData, bytes);
+		a_context->Unmap(staging.get(), 0);
+		return data;
+	}
+
+	static float RelativeError(const float4& a_value, const float4& a_reference)
+	{
+		float error = 0.0f;
+		for (float component : { a_value.x - a_reference.x, a_value.y - a_reference.y, a_value.z - a_reference.z })
+			error = std::max(error, std::abs(component));
+		return error / std::max(1.0f, std::max({ std::abs(a_reference.x), std::abs(a_reference.y), std::abs(a_reference.z) }));
+	}
+
+	ValidationResult Validate(ID3D11DeviceContext* a_context, const LightLimitFix::LightBuildingCB& a_cb, uint a_eyeCount,
+		std::span<const LightLimitFix::LightData> a_lights, ID3D11Buffer* a_clusters, ID3D11Buffer* a_lightList, ID3D11Buffer* a_lightGrid)
+	{
+		constexpr float clusterTolerance = 1e-3f;
+		ValidationResult result;
+
+		auto gpuClusters = ReadBack<LightLimitFix::ClusterAABB>(a_context, a_clusters);
+		auto gpuLightList = ReadBack<uint>(a_context, a_lightList);
+		auto gpuLightGrid = ReadBack<LightLimitFix::LightGrid>(a_context, a_lightGrid);
+		if (gpuClusters.size() < ClusterCount || gpuLightGrid.size() < ClusterCount || gpuLightList.size() < ClusterCount * MaxClusterLights) {
+			logger::error("[LLF] Cluster validation skipped, unexpected buffer sizes");
+			return result;
+		}
+
+		std::vector<LightLimitFix::ClusterAABB> clusters(ClusterCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		BuildClusters(a_cb, a_eyeCount, clusters);
+		auto built = std::chrono::high_resolution_clock::now();
+
+		std::vector<LightLimitFix::LightGrid> lightGrid(ClusterCount);
+		std::vector<uint> lightList(ClusterCount * MaxClusterLights);
+		CullLights(gpuClusters, a_lights, a_eyeCount, lightGrid, lightList);
+		auto culled = std::chrono::high_resolution_clock::now();
+
+		result.buildMs = std::chrono::duration<double, std::milli>(built - start).count();
+		result.cullMs = std::chrono::duration<double, std::milli>(culled - built).count();
+
+		for (uint i = 0; i < ClusterCount; i++) {
+			float error = std::max(RelativeError(gpuClusters[i].minPoint, clusters[i].minPoint), RelativeError(gpuClusters[i].maxPoint, clusters[i].maxPoint));
+			result.maxClusterError = std::max(result.maxClusterError, error);
+			if (error > clusterTolerance)
+				result.clusterMismatches++;
+
+			const auto& gpuCell = gpuLightGrid[i];
+			const auto& cell = lightGrid[i];
+			bool match = gpuCell.lightCount == cell.lightCount && gpuCell.lightCount <= MaxClusterLights &&
+			             gpuCell.offset <= gpuLightList.size() - gpuCell.lightCount &&
+			             std::equal(lightList.begin() + cell.offset, lightList.begin() + cell.offset + cell.lightCount, gpuLightList.begin() + gpuCell.offset);
+			if (!match) {
+				if (result.lightGridMismatches++ == 0) {
+					result.firstMismatch = i;
+					logger::warn("[LLF] Cluster {} light list mismatch: GPU {} lights at {}, CPU {} lights", i, gpuCell.lightCount, gpuCell.offset, cell.lightCount);
+				}
+			}
+		}
+
+		logger::info("[LLF] Cluster validation: {} lights, {} cluster mismatches (max error {}), {} light grid mismatches, CPU build {:.3f} ms, CPU cull {:.3f} ms",
+			a_lights.size(), result.clusterMismatches, result.maxClusterError, result.lightGridMismatches, result.buildMs, result.cullMs);
+		return result;
+	}
+}
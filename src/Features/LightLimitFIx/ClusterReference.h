@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Features/LightLimitFix.h"
+
+/**
+ * CPU reference for the Light Limit Fix compute kernels (ClusterBuildingCS and ClusterCullingCS).
+ * It uses the same buffer layouts as the GPU so readbacks can be compared directly, and doubles as
+ * a CPU fallback for culling.
+ */
+namespace ClusterReference
+{
+	inline constexpr uint ClusterSizeX = 16;
+	inline constexpr uint ClusterSizeY = 16;
+	inline constexpr uint ClusterSizeZ = 16;
+	inline constexpr uint ClusterCount = ClusterSizeX * ClusterSizeY * ClusterSizeZ;
+	inline constexpr uint MaxClusterLights = 128;
+
+	/**
+	 * Build the log-depth view-space cluster AABBs, matching ClusterBuildingCS.
+	 * Cluster index is x + y * ClusterSizeX + z * ClusterSizeX * ClusterSizeY.
+	 * @param a_eyeCount 2 merges both eyes' frusta like the VR permutation
+	 * @param a_clusters Output, ClusterCount entries
+	 */
+	void BuildClusters(const LightLimitFix::LightBuildingCB& a_cb, uint a_eyeCount, std::span<LightLimitFix::ClusterAABB> a_clusters);
+
+	/**
+	 * Cull lights against clusters, matching ClusterCullingCS.
+	 * Each cluster keeps its first MaxClusterLights intersecting lights in light order. Offsets are a
+	 * prefix sum in cluster order; the GPU allocates them with an atomic, so only per-cluster lists are
+	 * expected to match, not offsets.
+	 * @param a_lightGrid Output, ClusterCount entries
+	 * @param a_lightList Output, ClusterCount * MaxClusterLights entries
+	 * @return Total number of light indices written
+	 */
+	uint CullLights(std::span<const LightLimitFix::ClusterAABB> a_clusters, std::span<const LightLimitFix::LightData> a_lights, uint a_eyeCount,
+		std::span<LightLimitFix::LightGrid> a_lightGrid, std::span<uint> a_lightList);
+
+	struct ValidationResult
+	{
+		uint clusterMismatches = 0;   // AABBs outside tolerance
+		uint lightGridMismatches = 0;  // clusters whose light lists differ
+		float maxClusterError = 0.0f;
+		uint firstMismatch = UINT_MAX;  // first cluster whose light list differs
+		double buildMs = 0.0;
+		double cullMs = 0.0;
+	};
+
+	/**
+	 * Read back the GPU cluster and culling results and compare them with the CPU reference.
+	 * Culling is run against the GPU clusters so its output is compared exactly; cluster AABBs use a
+	 * relative tolerance since pow and division may round differently on the GPU.
+	 * This stalls the pipeline and is meant for developer-mode validation only.
+	 */
+	ValidationResult Validate(ID3D11DeviceContext* a_context, const LightLimitFix::LightBuildingCB& a_cb, uint a_eyeCount,
+		std::span<const LightLimitFix::LightData> a_lights, ID3D11Buffer* a_clusters, ID3D11Buffer* a_lightList, ID3D11Buffer* a_lightGrid);
+}
@@ -0,0 +1,104 @@
+#include "ParticleLightClustering.h"
+
+void ParticleLightClustering::Stats::Add(const Stats& a_other)
+{
+	particles += a_other.particles;
+	lights += a_other.lights;
+	weightedSpread += a_other.weightedSpread;
+	weight += a_other.weight;
+	milliseconds += a_other.milliseconds;
+}
+
+uint64_t ParticleLightClustering::Key(int32_t a_x, int32_t a_y, int32_t a_z)
+{
+	constexpr uint64_t mask = (1ull << 21) - 1;
+	return ((uint64_t(a_x) & mask) << 42) | ((uint64_t(a_y) & mask) << 21) | (uint64_t(a_z) & mask);
+}
+
+void ParticleLightClustering::Build(std::span<const Light> a_particles, float a_cellSize, uint a_maxLights, std::vector<Light>& o_lights)
+{
+	if (a_particles.empty())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	cells.clear();
+	cellIndex.clear();
+
+	const float invCellSize = 1.0f / std::max(a_cellSize, 1.0f);
+	for (const auto& particle : a_particles) {
+		int32_t x = (int32_t)std::floor(particle.position.x * invCellSize);
+		int32_t y = (int32_t)std::floor(particle.position.y * invCellSize);
+		int32_t z = (int32_t)std::floor(particle.position.z * invCellSize);
+
+		auto [it, inserted] = cellIndex.try_emplace(Key(x, y, z), (uint32_t)cells.size());
+		if (inserted)
+			cells.push_back({ x, y, z });
+
+		// Weight by luminance so bright particles pull the merged light towards them
+		double weight = std::max(particle.color.Dot(float3(0.3f, 0.59f, 0.11f)), 1e-4f);
+		auto& cell = cells[it->second];
+		cell.weight += weight;
+		cell.position[0] += weight * particle.position.x;
+		cell.position[1] += weight * particle.position.y;
+		cell.position[2] += weight * particle.position.z;
+		cell.positionSq += weight * particle.position.LengthSquared();
+		cell.radius += weight * particle.radius;
+		cell.color += particle.color;
+	}
+
+	for (uint level = 0; cells.size() > std::max(a_maxLights, 1u) && level < 16; level++)
+		Coarsen();
+
+	for (const auto& cell : cells) {
+		double invWeight = 1.0 / cell.weight;
+		double centroid[3] = { cell.position[0] * invWeight, cell.position[1] * invWeight, cell.position[2] * invWeight };
+		double variance = cell.positionSq * invWeight - (centroid[0] * centroid[0] + centroid[1] * centroid[1] + centroid[2] * centroid[2]);
+		float spread = (float)std::sqrt(std::max(variance, 0.0));
+
+		Light light;
+		light.position = { (float)centroid[0], (float)centroid[1], (float)centroid[2] };
+		light.radius = (float)(cell.radius * invWeight) + spread;
+		light.color = cell.color;
+		o_lights.push_back(light);
+
+		stats.weightedSpread += spread * cell.weight;
+		stats.weight += cell.weight;
+	}
+
+	stats.particles += (uint32_t)a_particles.size();
+	stats.lights += (uint32_t)cells.size();
+	stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ParticleLightClustering::Coarsen()
+{
+	coarseCells.clear();
+	cellIndex.clear();
+
+	for (const auto& cell : cells) {
+		// Arithmetic shift floors, so each cell lands in the parent that contains it
+		int32_t x = cell.x >> 1;
+		int32_t y = cell.y >> 1;
+		int32_t z = cell.z >> 1;
+
+		auto [it, inserted] = cellIndex.try_emplace(Key(x, y, z), (uint32_t)coarseCells.size());
+		if (inserted) {
+			coarseCells.push_back(cell);
+			coarseCells.back().x = x;
+			coarseCells.back().y = y;
+			coarseCells.back().z = z;
+			continue;
+		}
+
+		auto& parent = coarseCells[it->second];
+		parent.weight += cell.weight;
+		for (int i = 0; i < 3; i++)
+			parent.position[i] += cell.position[i];
+		parent.positionSq += cell.positionSq;
+		parent.radius += cell.radius;
+		parent.color += cell.color;
+	}
+
+	std::swap(cells, coarseCells);
+}
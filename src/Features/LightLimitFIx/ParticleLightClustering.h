@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+ * Merges the particles of one particle system into a bounded set of lights.
+ * Particles are binned into a world-space hash grid and each occupied cell becomes one light, so the
+ * result does not depend on particle order and stays stable as the camera moves. Colour is summed so the
+ * emitted energy is preserved; position is the luminance-weighted centroid and radius the weighted mean
+ * radius grown by the spread of the cell. When a system covers more cells than allowed, cells are
+ * coarsened by doubling their size until it fits.
+ * Systems share no state other than the scratch buffers, so one instance per thread can process them in parallel.
+ */
+class ParticleLightClustering
+{
+public:
+	struct Light
+	{
+		float3 position;
+		float radius;
+		float3 color;
+	};
+
+	/**
+	 * Cluster one particle system.
+	 * @param a_particles World-space particles, consumed as-is
+	 * @param a_cellSize Grid cell size in game units
+	 * @param a_maxLights Maximum number of lights emitted for this system
+	 * @param o_lights Lights are appended here
+	 */
+	void Build(std::span<const Light> a_particles, float a_cellSize, uint a_maxLights, std::vector<Light>& o_lights);
+
+	struct Stats
+	{
+		uint32_t particles = 0;
+		uint32_t lights = 0;
+		double weightedSpread = 0.0;  // luminance-weighted RMS distance of particles from their light
+		double weight = 0.0;
+		double milliseconds = 0.0;
+
+		float MeanSpread() const { return weight > 0.0 ? (float)(weightedSpread / weight) : 0.0f; }
+		void Add(const Stats& a_other);
+	};
+
+	Stats stats;
+
+private:
+	struct Cell
+	{
+		int32_t x;
+		int32_t y;
+		int32_t z;
+		double weight;
+		double position[3];
+		double positionSq;
+		double radius;
+		float3 color;
+	};
+
+	static uint64_t Key(int32_t a_x, int32_t a_y, int32_t a_z);
+	void Coarsen();
+
+	std::vector<Cell> cells;
+	std::vector<Cell> coarseCells;
+	ankerl::unordered_dense::map<uint64_t, uint32_t> cellIndex;
+};
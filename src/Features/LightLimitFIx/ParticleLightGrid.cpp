@@ -0,0 +1,71 @@
+#include "ParticleLightGrid.h"
+
+uint64_t ParticleLightGrid::Key(int32_t a_x, int32_t a_y, int32_t a_z)
+{
+	constexpr uint64_t mask = (1ull << 21) - 1;
+	return ((uint64_t(a_x) & mask) << 42) | ((uint64_t(a_y) & mask) << 21) | (uint64_t(a_z) & mask);
+}
+
+ParticleLightGrid::ParticleLightGrid(std::vector<Light>&& a_lights) :
+	lights(std::move(a_lights))
+{
+	struct Bounds
+	{
+		int32_t min[3];
+		int32_t max[3];
+	};
+
+	auto getBounds = [](const Light& a_light) {
+		Bounds bounds;
+		const float position[3] = { a_light.position.x, a_light.position.y, a_light.position.z };
+		for (int i = 0; i < 3; i++) {
+			bounds.min[i] = CellCoordinate(position[i] - a_light.radius);
+			bounds.max[i] = CellCoordinate(position[i] + a_light.radius);
+		}
+		return bounds;
+	};
+
+	auto forEachCell = [](const Bounds& a_bounds, auto&& a_func) {
+		for (int32_t z = a_bounds.min[2]; z <= a_bounds.max[2]; z++)
+			for (int32_t y = a_bounds.min[1]; y <= a_bounds.max[1]; y++)
+				for (int32_t x = a_bounds.min[0]; x <= a_bounds.max[0]; x++)
+					a_func(Key(x, y, z));
+	};
+
+	// Count lights per cell, then lay out the cells and fill them in light order
+
+	std::vector<uint8_t> large(lights.size());
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < lights.size(); i++) {
+		auto bounds = getBounds(lights[i]);
+		uint64_t cellCount = 1;
+		for (int axis = 0; axis < 3; axis++)
+			cellCount *= uint64_t(bounds.max[axis] - bounds.min[axis] + 1);
+
+		if (cellCount > MaxCellsPerLight) {
+			large[i] = true;
+			largeLights.push_back(i);
+			continue;
+		}
+
+		forEachCell(bounds, [&](uint64_t a_key) { cells[a_key].count++; });
+		total += (uint32_t)cellCount;
+	}
+
+	uint32_t offset = 0;
+	for (auto& [key, cell] : cells) {
+		cell.offset = offset;
+		offset += cell.count;
+		cell.count = 0;
+	}
+
+	cellLights.resize(total);
+	for (uint32_t i = 0; i < lights.size(); i++) {
+		if (large[i])
+			continue;
+		forEachCell(getBounds(lights[i]), [&](uint64_t a_key) {
+			auto& cell = cells[a_key];
+			cellLights[cell.offset + cell.count++] = i;
+		});
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * Read-only uniform grid over one frame's particle lights, used for AI light level queries.
+ * Each light is listed in every cell its bounding box touches, so a query only visits the cell holding
+ * the point. Lights covering too many cells are kept in a separate list that every query visits.
+ * The grid is immutable once built, so other threads can query it without locking as long as the
+ * owner keeps it alive until they are done.
+ */
+class ParticleLightGrid
+{
+public:
+	struct Light
+	{
+		float grey;
+		RE::NiPoint3 position;
+		float radius;
+	};
+
+	explicit ParticleLightGrid(std::vector<Light>&& a_lights);
+
+	/** Call a_visitor with every light whose bounds may contain a_point. */
+	template <class Visitor>
+	void Query(const RE::NiPoint3& a_point, Visitor&& a_visitor) const
+	{
+		if (auto it = cells.find(Key(a_point)); it != cells.end()) {
+			for (uint32_t i = it->second.offset; i < it->second.offset + it->second.count; i++)
+				a_visitor(lights[cellLights[i]]);
+		}
+		for (uint32_t index : largeLights)
+			a_visitor(lights[index]);
+	}
+
+	size_t size() const { return lights.size(); }
+
+private:
+	static constexpr float CellSize = 512.0f;
+	static constexpr uint32_t MaxCellsPerLight = 64;
+
+	struct Cell
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	static int32_t CellCoordinate(float a_value) { return (int32_t)std::floor(a_value * (1.0f / CellSize)); }
+	static uint64_t Key(int32_t a_x, int32_t a_y, int32_t a_z);
+	static uint64_t Key(const RE::NiPoint3& a_point) { return Key(CellCoordinate(a_point.x), CellCoordinate(a_point.y), CellCoordinate(a_point.z)); }
+
+	std::vector<Light> lights;
+	std::vector<uint32_t> cellLights;  // light indices grouped by cell
+	std::vector<uint32_t> largeLights;
+	ankerl::unordered_dense::map<uint64_t, Cell> cells;
+};
@@ -4,6 +4,8 @@
 
 void ParticleLights::GetConfigs()
 {
+	generation++;
+
 	if (std::filesystem::exists("Data\\ParticleLights")) {
 		logger::info("[LLF] Loading particle lights configs");
 
@@ -35,5 +35,8 @@ public:
 	ankerl::unordered_dense::map<std::string, Config> particleLightConfigs;
 	ankerl::unordered_dense::map<std::string, GradientConfig> particleLightGradientConfigs;
 
+	// Incremented whenever the configs are reloaded, so cached pointers into them can be dropped
+	uint32_t generation = 0;
+
 	void GetConfigs();
 };
\ No newline at end of file
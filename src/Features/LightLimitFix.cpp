@@ -1,10 +1,11 @@
 #include "LightLimitFix.h"
 
-#include <PerlinNoise.hpp>
-
 #include "State.h"
+#include "BindingCache.h"
 #include "Util.h"
 
+#include "LightLimitFix/ClusterReference.h"
+
 static constexpr uint CLUSTER_SIZE_X = 16;
 static constexpr uint CLUSTER_SIZE_Y = 16;
 static constexpr uint CLUSTER_SIZE_Z = 16;
@@ -12,7 +13,11 @@ constexpr uint CLUSTER_MAX_LIGHTS = 128;
 
 constexpr std::uint32_t CLUSTER_COUNT = CLUSTER_SIZE_X * CLUSTER_SIZE_Y * CLUSTER_SIZE_Z;
 
-static constexpr uint MAX_LIGHTS = 2048;
+static constexpr uint INITIAL_LIGHT_CAPACITY = 2048;
+static constexpr uint MAX_LIGHTS = 16384;  // light budget; the buffer grows up to this on demand
+static constexpr uint STRICT_LIGHT_RING_SIZE = 2048;
+
+static_assert(CLUSTER_COUNT == ClusterReference::ClusterCount && CLUSTER_MAX_LIGHTS == ClusterReference::MaxClusterLights);
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
 	LightLimitFix::Settings,
@@ -24,6 +29,7 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
 	ParticleLightsSaturation,
 	EnableParticleLightsOptimization,
 	ParticleLightsOptimisationClusterRadius,
+	ParticleLightsOptimisationMaxLights,
 	ParticleBrightness,
 	ParticleRadius,
 	BillboardBrightness,
@@ -53,7 +59,11 @@ void LightLimitFix::DrawSettings()
 		}
 		ImGui::SliderInt("Optimisation Cluster Radius", (int*)&settings.ParticleLightsOptimisationClusterRadius, 1, 64);
 		if (auto _tt = Util::HoverTooltipWrapper()) {
-			ImGui::Text("Radius to use for clustering lights.");
+			ImGui::Text("Size of the grid cells particles are merged in.");
+		}
+		ImGui::SliderInt("Optimisation Max Lights", (int*)&settings.ParticleLightsOptimisationMaxLights, 1, 128);
+		if (auto _tt = Util::HoverTooltipWrapper()) {
+			ImGui::Text("Maximum number of lights a single particle system can produce. Cells are enlarged until the system fits.");
 		}
 		ImGui::Spacing();
 		ImGui::Spacing();
@@ -112,8 +122,37 @@ void LightLimitFix::DrawSettings()
 	}
 
 	if (ImGui::TreeNodeEx("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
-		ImGui::Text(std::format("Clustered Light Count : {}", lightCount).c_str());
-		ImGui::Text(std::format("Particle Lights Detection Count : {}", particleLightsDetectionHits).c_str());
+		clusterStatisticsVisible = true;
+		ImGui::Text(std::format("Clustered Light Count : {} (capacity {})", lightCount, lightCapacity).c_str());
+		ImGui::Text(std::format("Dropped Lights : {} over budget, {} cluster slots overflowed", droppedLights, clusterOverflowSlots).c_str());
+		ImGui::Text(std::format("Cluster Occupancy : {} empty, {} 1-15, {} 16-31, {} 32-63, {} 64-127, {} full",
+			clusterOccupancy[0], clusterOccupancy[1], clusterOccupancy[2], clusterOccupancy[3], clusterOccupancy[4], clusterOccupancy[5])
+						.c_str());
+		ImGui::Text(std::format("Particle Lights Detection Count : {}", particleLightsDetectionHits.load()).c_str());
+		ImGui::Text(std::format("Particle Light Queries : {} queries tested {} lights last frame", particleLightQueriesLastFrame, particleLightsTestedLastFrame).c_str());
+		ImGui::Text(std::format("Particle Light Configs : {} textures cached, {} resolved last frame", particleLightConfigCache.size(), particleLightConfigResolvesLastFrame).c_str());
+		ImGui::Text(std::format("Particle Light Clustering : {} particles to {} lights, {:.1f} mean spread, {:.3f} ms",
+			particleLightClusteringStats.particles, particleLightClusteringStats.lights, particleLightClusteringStats.MeanSpread(), particleLightClusteringStats.milliseconds)
+						.c_str());
+		ImGui::Text(std::format("Light Gathering : {:.3f} ms on {} threads ({} particle sources)", gatherMilliseconds, gatherThreadCount, particleLightSources.size()).c_str());
+		ImGui::Text(std::format("Flicker States : {} cached, {} created last frame", flickerStates.size(), flickerStatesCreated).c_str());
+		ImGui::Text(std::format("Strict Light Sets : {} uploaded for {} draws", strictLightUploadsLastFrame, strictLightDrawsLastFrame).c_str());
+
+		if (State::GetSingleton()->IsDeveloperMode()) {
+			ImGui::SliderInt("Gather Threads", (int*)&gatherThreadCount, 1, 16);
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text("Threads used to gather point and particle lights, including the render thread. ");
+			}
+			if (ImGui::Button("Validate Clusters"))
+				validateClusters = true;
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text(
+					"Reads back the GPU cluster and light grid buffers and compares them with the CPU reference. "
+					"Stalls the GPU for a frame. Results are also written to the log. ");
+			}
+			if (!clusterValidationStatus.empty())
+				ImGui::Text(clusterValidationStatus.c_str());
+		}
 
 		ImGui::TreePop();
 	}
@@ -146,15 +185,27 @@ void LightLimitFix::SetupResources()
 		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 		sbDesc.StructureByteStride = sizeof(StrictLightData);
-		sbDesc.ByteWidth = sizeof(StrictLightData);
+		sbDesc.ByteWidth = sizeof(StrictLightData) * STRICT_LIGHT_RING_SIZE;
 		strictLightData = std::make_unique<Buffer>(sbDesc);
 
+		auto& device = State::GetSingleton()->device;
+
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
 		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
 		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-		srvDesc.Buffer.FirstElement = 0;
 		srvDesc.Buffer.NumElements = 1;
-		strictLightData->CreateSRV(srvDesc);
+		strictLightViews.resize(STRICT_LIGHT_RING_SIZE);
+		for (uint i = 0; i < STRICT_LIGHT_RING_SIZE; i++) {
+			srvDesc.Buffer.FirstElement = i;
+			DX::ThrowIfFailed(device->CreateShaderResourceView(strictLightData->resource.get(), &srvDesc, strictLightViews[i].put()));
+		}
+
+		// appending to a dynamic structured buffer without discarding needs D3D11.1 driver support
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+		if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+			strictLightNoOverwrite = options.MapNoOverwriteOnDynamicBufferSRV;
+		if (!strictLightNoOverwrite)
+			logger::info("[LLF] Strict light ring unavailable; uploading with WRITE_DISCARD");
 	}
 
 	{
@@ -221,23 +272,30 @@ void LightLimitFix::SetupResources()
 		lightGrid->CreateUAV(uavDesc);
 	}
 
-	{
-		D3D11_BUFFER_DESC sbDesc{};
-		sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-		sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-		sbDesc.StructureByteStride = sizeof(LightData);
-		sbDesc.ByteWidth = sizeof(LightData) * MAX_LIGHTS;
-		lights = eastl::make_unique<Buffer>(sbDesc);
+	CreateLightBuffer(INITIAL_LIGHT_CAPACITY);
+}
 
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-		srvDesc.Buffer.FirstElement = 0;
-		srvDesc.Buffer.NumElements = MAX_LIGHTS;
-		lights->CreateSRV(srvDesc);
-	}
+void LightLimitFix::CreateLightBuffer(std::uint32_t a_capacity)
+{
+	D3D11_BUFFER_DESC sbDesc{};
+	sbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	sbDesc.StructureByteStride = sizeof(LightData);
+	sbDesc.ByteWidth = sizeof(LightData) * a_capacity;
+	lights = eastl::make_unique<Buffer>(sbDesc);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = a_capacity;
+	lights->CreateSRV(srvDesc);
+
+	if (lightCapacity)
+		logger::info("[LLF] Growing light buffer from {} to {} lights", lightCapacity, a_capacity);
+	lightCapacity = a_capacity;
 }
 
 void LightLimitFix::Reset()
@@ -254,6 +312,12 @@ void LightLimitFix::Reset()
 	particleLights.clear();
 	std::swap(particleLights, queuedParticleLights);
 	boundViews = false;
+	boundStrictLightSlot = UINT32_MAX;
+	strictLightDrawsLastFrame = std::exchange(strictLightDraws, 0);
+	strictLightUploadsLastFrame = std::exchange(strictLightUploads, 0);
+	particleLightConfigResolvesLastFrame = std::exchange(particleLightConfigResolves, 0);
+	particleLightQueriesLastFrame = particleLightQueries.exchange(0, std::memory_order_relaxed);
+	particleLightsTestedLastFrame = particleLightsTested.exchange(0, std::memory_order_relaxed);
 }
 
 void LightLimitFix::Load(json& o_json)
@@ -307,16 +371,44 @@ void LightLimitFix::BSLightingShader_SetupGeometry_GeometrySetupConstantPointLig
 
 void LightLimitFix::BSLightingShader_SetupGeometry_After(RE::BSRenderPass*)
 {
-	static bool wasEmpty = false;
-	bool isEmpty = strictLightDataTemp.NumLights == 0;
-	if (!isEmpty || (isEmpty && !wasEmpty)) {
-		auto& context = State::GetSingleton()->context;
+	auto& context = State::GetSingleton()->context;
+	strictLightDraws++;
+
+	// only the used lights and the count are read, so only they are hashed and uploaded
+	size_t lightBytes = sizeof(LightData) * strictLightDataTemp.NumLights;
+	uint64_t hash = ankerl::unordered_dense::detail::wyhash::hash(strictLightDataTemp.StrictLights, lightBytes) ^ strictLightDataTemp.NumLights;
+
+	uint32_t slot;
+	if (auto it = strictLightSlots.find(hash); it != strictLightSlots.end()) {
+		slot = it->second;
+	} else {
+		D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+		if (!strictLightNoOverwrite || strictLightRingPosition == STRICT_LIGHT_RING_SIZE) {
+			// wrapped; earlier slots may still be in use by the GPU
+			mapType = D3D11_MAP_WRITE_DISCARD;
+			strictLightRingPosition = 0;
+			strictLightSlots.clear();
+		}
+		slot = strictLightRingPosition++;
+		strictLightSlots.emplace(hash, slot);
+		strictLightUploads++;
+
 		D3D11_MAPPED_SUBRESOURCE mapped;
-		DX::ThrowIfFailed(context->Map(strictLightData->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-		size_t bytes = sizeof(StrictLightData);
-		memcpy_s(mapped.pData, bytes, &strictLightDataTemp, bytes);
+		DX::ThrowIfFailed(context->Map(strictLightData->resource.get(), 0, mapType, 0, &mapped));
+		auto& data = static_cast<StrictLightData*>(mapped.pData)[slot];
+		memcpy_s(data.StrictLights, sizeof(data.StrictLights), strictLightDataTemp.StrictLights, lightBytes);
+		data.NumLights = strictLightDataTemp.NumLights;
 		context->Unmap(strictLightData->resource.get(), 0);
-		wasEmpty = isEmpty;
+
+		// a discard invalidates what was bound, even if the slot index is unchanged
+		if (mapType == D3D11_MAP_WRITE_DISCARD)
+			boundStrictLightSlot = UINT32_MAX;
+	}
+
+	if (slot != boundStrictLightSlot) {
+		boundStrictLightSlot = slot;
+		ID3D11ShaderResourceView* view = strictLightViews[slot].get();
+		context->PSSetShaderResources(37, 1, &view);
 	}
 }
 
@@ -347,7 +439,7 @@ void LightLimitFix::SetLightPosition(LightLimitFix::LightData& a_light, RE::NiPo
 	}
 }
 
-float LightLimitFix::CalculateLuminance(CachedParticleLight& light, RE::NiPoint3& point)
+float LightLimitFix::CalculateLuminance(const CachedParticleLight& light, const RE::NiPoint3& point)
 {
 	// See BSLight::CalculateLuminance_14131D3D0
 	// Performs lighting on the CPU which is identical to GPU code
@@ -362,17 +454,23 @@ float LightLimitFix::CalculateLuminance(CachedParticleLight& light, RE::NiPoint3
 
 void LightLimitFix::AddParticleLightLuminance(RE::NiPoint3& targetPosition, int& numHits, float& lightLevel)
 {
-	std::lock_guard<std::shared_mutex> lk{ cachedParticleLightsMutex };
-	particleLightsDetectionHits = 0;
+	std::uint32_t hits = 0;
 	if (settings.EnableParticleLightsDetection) {
-		for (auto& light : cachedParticleLights) {
-			auto luminance = CalculateLuminance(light, targetPosition);
-			lightLevel += luminance;
-			if (luminance > 0.0)
-				particleLightsDetectionHits++;
+		if (auto grid = particleLightGrid.load(std::memory_order_acquire)) {
+			std::uint32_t tested = 0;
+			grid->Query(targetPosition, [&](const CachedParticleLight& light) {
+				auto luminance = CalculateLuminance(light, targetPosition);
+				lightLevel += luminance;
+				if (luminance > 0.0)
+					hits++;
+				tested++;
+			});
+			particleLightQueries.fetch_add(1, std::memory_order_relaxed);
+			particleLightsTested.fetch_add(tested, std::memory_order_relaxed);
 		}
 	}
-	numHits += particleLightsDetectionHits;
+	particleLightsDetectionHits.store(hits, std::memory_order_relaxed);
+	numHits += hits;
 }
 
 void LightLimitFix::Bind()
@@ -388,10 +486,7 @@ void LightLimitFix::Bind()
 		boundViews = true;
 
 		ID3D11ShaderResourceView* view = perPass->srv.get();
-		context->PSSetShaderResources(32, 1, &view);
-
-		view = strictLightData->srv.get();
-		context->PSSetShaderResources(37, 1, &view);
+		BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 32, 1, &view);
 	}
 
 	if (reflections || accumulator->GetRuntimeData().activeShadowSceneNode != RE::BSShaderManager::State::GetSingleton().shadowSceneNode[0]) {
@@ -412,7 +507,7 @@ void LightLimitFix::Bind()
 			views[0] = lights->srv.get();
 			views[1] = lightList->srv.get();
 			views[2] = lightGrid->srv.get();
-			context->PSSetShaderResources(17, ARRAYSIZE(views), views);
+			BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 17, ARRAYSIZE(views), views);
 			perPassData.EnableGlobalLights = false;
 		}
 
@@ -490,29 +585,21 @@ std::optional<LightLimitFix::ConfigPair> LightLimitFix::GetParticleLightConfigs(
 			if (!shaderProperty->lightData) {
 				if (auto material = shaderProperty->GetMaterial()) {
 					if (!material->sourceTexturePath.empty()) {
-						std::string textureName = ExtractTextureStem(material->sourceTexturePath.c_str());
-						if (textureName.size() < 1)
-							return std::nullopt;
-
-						auto& configs = ParticleLights::GetSingleton()->particleLightConfigs;
-						auto it = configs.find(textureName);
-						if (it == configs.end())
-							return std::nullopt;
-
-						ParticleLights::Config* config = &it->second;
-						ParticleLights::GradientConfig* gradientConfig = nullptr;
-						if (!material->greyscaleTexturePath.empty()) {
-							textureName = ExtractTextureStem(material->greyscaleTexturePath.c_str());
-							if (textureName.size() < 1)
-								return std::nullopt;
-
-							auto& gradientConfigs = ParticleLights::GetSingleton()->particleLightGradientConfigs;
-							auto itGradient = gradientConfigs.find(textureName);
-							if (itGradient == gradientConfigs.end())
-								return std::nullopt;
-							gradientConfig = &itGradient->second;
+						auto particleLights = ParticleLights::GetSingleton();
+						if (particleLightConfigGeneration != particleLights->generation) {
+							particleLightConfigGeneration = particleLights->generation;
+							particleLightConfigCache.clear();
 						}
-						return std::make_pair(config, gradientConfig);
+
+						const char* greyscaleTexturePath = material->greyscaleTexturePath.empty() ? nullptr : material->greyscaleTexturePath.data();
+						ParticleLightConfigKey key{ material->sourceTexturePath.data(), greyscaleTexturePath };
+						if (auto it = particleLightConfigCache.find(key); it != particleLightConfigCache.end())
+							return it->second.configs;
+
+						particleLightConfigResolves++;
+						auto configs = ResolveParticleLightConfigs(material->sourceTexturePath.c_str(), greyscaleTexturePath ? greyscaleTexturePath : std::string_view{});
+						particleLightConfigCache.emplace(key, ParticleLightConfigEntry{ material->sourceTexturePath, material->greyscaleTexturePath, configs });
+						return configs;
 					}
 				}
 			}
@@ -521,6 +608,33 @@ std::optional<LightLimitFix::ConfigPair> LightLimitFix::GetParticleLightConfigs(
 	return std::nullopt;
 }
 
+std::optional<LightLimitFix::ConfigPair> LightLimitFix::ResolveParticleLightConfigs(std::string_view a_sourceTexturePath, std::string_view a_greyscaleTexturePath)
+{
+	std::string textureName = ExtractTextureStem(a_sourceTexturePath);
+	if (textureName.size() < 1)
+		return std::nullopt;
+
+	auto& configs = ParticleLights::GetSingleton()->particleLightConfigs;
+	auto it = configs.find(textureName);
+	if (it == configs.end())
+		return std::nullopt;
+
+	ParticleLights::Config* config = &it->second;
+	ParticleLights::GradientConfig* gradientConfig = nullptr;
+	if (!a_greyscaleTexturePath.empty()) {
+		textureName = ExtractTextureStem(a_greyscaleTexturePath);
+		if (textureName.size() < 1)
+			return std::nullopt;
+
+		auto& gradientConfigs = ParticleLights::GetSingleton()->particleLightGradientConfigs;
+		auto itGradient = gradientConfigs.find(textureName);
+		if (itGradient == gradientConfigs.end())
+			return std::nullopt;
+		gradientConfig = &itGradient->second;
+	}
+	return std::make_pair(config, gradientConfig);
+}
+
 bool LightLimitFix::CheckParticleLights(RE::BSRenderPass* a_pass, uint32_t)
 {
 	auto configs = GetParticleLightConfigs(a_pass);
@@ -626,6 +740,19 @@ void LightLimitFix::Draw(const RE::BSShader* shader, const uint32_t)
 	}
 }
 
+bool LightLimitFix::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Lighting:
+	case RE::BSShader::Type::Grass:
+	case RE::BSShader::Type::Effect:
+	case RE::BSShader::Type::Water:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void LightLimitFix::PostPostLoad()
 {
 	ParticleLights::GetSingleton()->GetConfigs();
@@ -644,7 +771,7 @@ float LightLimitFix::CalculateLightDistance(float3 a_lightPosition, float a_radi
 	return (a_lightPosition.x * a_lightPosition.x) + (a_lightPosition.y * a_lightPosition.y) + (a_lightPosition.z * a_lightPosition.z) - (a_radius * a_radius);
 }
 
-void LightLimitFix::AddCachedParticleLights(eastl::vector<LightData>& lightsData, LightLimitFix::LightData& light, ParticleLights::Config* a_config, RE::BSGeometry* a_geometry, double a_timer)
+bool LightLimitFix::PrepareParticleLight(LightLimitFix::LightData& light, const ParticleLights::Config* a_config, const FlickerState* a_flicker, double a_timer)
 {
 	static float& lightFadeStart = (*(float*)REL::RelocationID(527668, 414582).address());
 	static float& lightFadeEnd = (*(float*)REL::RelocationID(527669, 414583).address());
@@ -676,40 +803,42 @@ void LightLimitFix::AddCachedParticleLights(eastl::vector<LightData>& lightsData
 
 	light.color *= dimmer;
 
-	if ((light.color.x + light.color.y + light.color.z) > 1e-4 && light.radius > 1e-4) {
-		if (a_geometry && a_config && a_config->flicker) {
-			auto seed = (std::uint32_t)std::hash<void*>{}(a_geometry);
+	if ((light.color.x + light.color.y + light.color.z) <= 1e-4 || light.radius <= 1e-4)
+		return false;
 
-			siv::PerlinNoise perlin1{ seed };
-			siv::PerlinNoise perlin2{ seed + 1 };
-			siv::PerlinNoise perlin3{ seed + 2 };
-			siv::PerlinNoise perlin4{ seed + 3 };
+	if (a_flicker && a_config) {
+		auto scaledTimer = a_timer * a_config->flickerSpeed;
 
-			auto scaledTimer = a_timer * a_config->flickerSpeed;
+		float3 movement = {
+			(float)a_flicker->movement[0].noise1D(scaledTimer) * a_config->flickerMovement,
+			(float)a_flicker->movement[1].noise1D(scaledTimer) * a_config->flickerMovement,
+			(float)a_flicker->movement[2].noise1D(scaledTimer) * a_config->flickerMovement
+		};
+		for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++)
+			light.positionWS[eyeIndex].data += movement;
 
-			for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++) {
-				light.positionWS[eyeIndex].data.x += (float)perlin1.noise1D(scaledTimer) * a_config->flickerMovement;
-				light.positionWS[eyeIndex].data.y += (float)perlin2.noise1D(scaledTimer) * a_config->flickerMovement;
-				light.positionWS[eyeIndex].data.z += (float)perlin3.noise1D(scaledTimer) * a_config->flickerMovement;
-			}
+		float intensity = (float)a_flicker->intensity.noise1D_01(scaledTimer) * a_config->flickerIntensity;
+		light.color.x = std::max(0.0f, light.color.x - intensity);
+		light.color.y = std::max(0.0f, light.color.y - intensity);
+		light.color.z = std::max(0.0f, light.color.z - intensity);
+	}
 
-			light.color.x = std::max(0.0f, light.color.x - ((float)perlin4.noise1D_01(scaledTimer) * a_config->flickerIntensity));
-			light.color.y = std::max(0.0f, light.color.y - ((float)perlin4.noise1D_01(scaledTimer) * a_config->flickerIntensity));
-			light.color.z = std::max(0.0f, light.color.z - ((float)perlin4.noise1D_01(scaledTimer) * a_config->flickerIntensity));
-		}
+	for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++)
+		light.positionVS[eyeIndex].data = DirectX::SimpleMath::Vector3::Transform(light.positionWS[eyeIndex].data, viewMatrixCached[eyeIndex]);
 
-		for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++)
-			light.positionVS[eyeIndex].data = DirectX::SimpleMath::Vector3::Transform(light.positionWS[eyeIndex].data, viewMatrixCached[eyeIndex]);
+	return true;
+}
 
-		lightsData.push_back(light);
+void LightLimitFix::AddCachedParticleLights(eastl::vector<LightData>& lightsData, const LightLimitFix::LightData& light)
+{
+	lightsData.push_back(light);
 
-		CachedParticleLight cachedParticleLight{};
-		cachedParticleLight.grey = float3(light.color.x, light.color.y, light.color.z).Dot(float3(0.3f, 0.59f, 0.11f));
-		cachedParticleLight.radius = light.radius;
-		cachedParticleLight.position = { light.positionWS[0].data.x + eyePositionCached[0].x, light.positionWS[0].data.y + eyePositionCached[0].y, light.positionWS[0].data.z + eyePositionCached[0].z };
+	CachedParticleLight cachedParticleLight{};
+	cachedParticleLight.grey = float3(light.color.x, light.color.y, light.color.z).Dot(float3(0.3f, 0.59f, 0.11f));
+	cachedParticleLight.radius = light.radius;
+	cachedParticleLight.position = { light.positionWS[0].data.x + eyePositionCached[0].x, light.positionWS[0].data.y + eyePositionCached[0].y, light.positionWS[0].data.z + eyePositionCached[0].z };
 
-		cachedParticleLights.push_back(cachedParticleLight);
-	}
+	cachedParticleLights.push_back(cachedParticleLight);
 }
 
 float3 LightLimitFix::Saturation(float3 color, float saturation)
@@ -768,158 +897,260 @@ void LightLimitFix::UpdateLights()
 		}
 	}
 
-	eastl::vector<LightData> lightsData{};
-	lightsData.reserve(MAX_LIGHTS);
+	auto& activePointLights = shadowSceneNode->GetRuntimeData().activePointLights;
+	auto timer = State::GetSingleton()->timer;
+
+	// Lay out the slab: one entry per point light, then one per particle or billboard
+
+	particleLightSources.clear();
+	flickerFrame++;
+	flickerStatesCreated = 0;
+	for (const auto& particleLight : particleLights) {
+		ParticleLightSource source{ particleLight.first, &particleLight.second, nullptr, 1, nullptr };
+		if (const auto particleSystem = netimmerse_cast<RE::NiParticleSystem*>(particleLight.first);
+			particleSystem && particleSystem->GetParticleRuntimeData().particleData.get()) {
+			source.particleSystem = particleSystem;
+			source.particleCount = particleSystem->GetParticleRuntimeData().particleData->GetActiveVertexCount();
+		} else if (particleLight.second.config.flicker) {
+			// Looked up here rather than in the jobs so the cache is only touched from this thread
+			auto& flicker = flickerStates[particleLight.first];
+			if (!flicker) {
+				flicker = std::make_unique<FlickerState>((std::uint32_t)std::hash<void*>{}(particleLight.first));
+				flickerStatesCreated++;
+			}
+			flicker->lastUsed = flickerFrame;
+			source.flicker = flicker.get();
+		}
+		particleLightSources.push_back(source);
+	}
 
-	// Process point lights
+	// The seed only depends on the pointer, so a recycled geometry address reuses its state safely
+	for (auto it = flickerStates.begin(); it != flickerStates.end();) {
+		if (flickerFrame - it->second->lastUsed > 60)
+			it = flickerStates.erase(it);
+		else
+			++it;
+	}
 
-	for (auto& e : shadowSceneNode->GetRuntimeData().activePointLights) {
-		if (auto bsLight = e.get()) {
-			if (auto niLight = bsLight->light.get()) {
-				if (IsValidLight(bsLight) && IsGlobalLight(bsLight)) {
-					auto& runtimeData = niLight->GetLightRuntimeData();
+	const uint32_t pointLightCount = activePointLights.size();
+	const uint32_t sourceCount = pointLightCount + (uint32_t)particleLightSources.size();
 
-					LightData light{};
-					light.color = { runtimeData.diffuse.red, runtimeData.diffuse.green, runtimeData.diffuse.blue };
-					light.color *= runtimeData.fade;
-					light.color *= bsLight->lodDimmer;
+	gatherOffsets.resize(sourceCount);
+	gatherCounts.assign(sourceCount, 0);
+	uint32_t slabSize = 0;
+	for (uint32_t i = 0; i < sourceCount; i++) {
+		gatherOffsets[i] = slabSize;
+		slabSize += i < pointLightCount ? 1 : particleLightSources[i - pointLightCount].particleCount;
+	}
+	if (gatherSlab.size() < slabSize)
+		gatherSlab.resize(slabSize);
 
-					light.radius = runtimeData.radius.x;
+	// Process point lights
 
-					SetLightPosition(light, niLight->world.translate);
+	auto gatherPointLight = [&](uint32_t a_index, LightData* o_light) -> uint32_t {
+		auto bsLight = activePointLights[a_index].get();
+		if (!bsLight)
+			return 0;
+		auto niLight = bsLight->light.get();
+		if (!niLight || !IsValidLight(bsLight) || !IsGlobalLight(bsLight))
+			return 0;
 
-					static float& lightFadeStart = (*(float*)REL::RelocationID(527668, 414582).address());
-					static float& lightFadeEnd = (*(float*)REL::RelocationID(527669, 414583).address());
+		auto& runtimeData = niLight->GetLightRuntimeData();
 
-					float distance = CalculateLightDistance(light.positionWS[0].data, light.radius);
+		LightData light{};
+		light.color = { runtimeData.diffuse.red, runtimeData.diffuse.green, runtimeData.diffuse.blue };
+		light.color *= runtimeData.fade;
+		light.color *= bsLight->lodDimmer;
 
-					float distantLightFadeStart = lightsFar * lightsFar * (lightFadeStart / lightFadeEnd);
-					float distantLightFadeEnd = lightsFar * lightsFar;
+		light.radius = runtimeData.radius.x;
 
-					float dimmer;
+		SetLightPosition(light, niLight->world.translate);
 
-					if (distance < distantLightFadeStart || distantLightFadeEnd == 0.0f) {
-						dimmer = 1.0f;
-					} else if (distance <= distantLightFadeEnd) {
-						dimmer = 1.0f - ((distance - distantLightFadeStart) / (distantLightFadeEnd - distantLightFadeStart));
-					} else {
-						dimmer = 0.0f;
-					}
+		static float& lightFadeStart = (*(float*)REL::RelocationID(527668, 414582).address());
+		static float& lightFadeEnd = (*(float*)REL::RelocationID(527669, 414583).address());
 
-					light.color *= dimmer;
+		float distance = CalculateLightDistance(light.positionWS[0].data, light.radius);
 
-					if ((light.color.x + light.color.y + light.color.z) > 1e-4 && light.radius > 1e-4) {
-						light.firstPersonShadow = bsLight == firstPersonLight || bsLight == thirdPersonLight || niLight == refLight || niLight == magicLight;
-						lightsData.push_back(light);
-					}
-				}
-			}
-		}
-	}
+		float distantLightFadeStart = lightsFar * lightsFar * (lightFadeStart / lightFadeEnd);
+		float distantLightFadeEnd = lightsFar * lightsFar;
 
-	{
-		std::lock_guard<std::shared_mutex> lk{ cachedParticleLightsMutex };
-		cachedParticleLights.clear();
-
-		LightData clusteredLight{};
-		uint32_t clusteredLights = 0;
-
-		auto eyePositionOffset = eyePositionCached[0] - eyePositionCached[1];
-
-		for (const auto& particleLight : particleLights) {
-			if (const auto particleSystem = netimmerse_cast<RE::NiParticleSystem*>(particleLight.first);
-				particleSystem && particleSystem->GetParticleRuntimeData().particleData.get()) {
-				// Process BSGeometry
-				auto particleData = particleSystem->GetParticleRuntimeData().particleData.get();
-
-				auto numVertices = particleData->GetActiveVertexCount();
-				for (std::uint32_t p = 0; p < numVertices; p++) {
-					float radius = particleData->GetParticlesRuntimeData().sizes[p] * 70.0f;
-
-					auto initialPosition = particleData->GetParticlesRuntimeData().positions[p];
-					if (!particleSystem->GetParticleSystemRuntimeData().isWorldspace) {
-						// Detect first-person meshes
-						if ((particleLight.first->GetModelData().modelBound.radius * particleLight.first->world.scale) != particleLight.first->worldBound.radius)
-							initialPosition += particleLight.first->worldBound.center;
-						else
-							initialPosition += particleLight.first->world.translate;
-					}
+		float dimmer;
 
-					RE::NiPoint3 positionWS = initialPosition - eyePositionCached[0];
+		if (distance < distantLightFadeStart || distantLightFadeEnd == 0.0f) {
+			dimmer = 1.0f;
+		} else if (distance <= distantLightFadeEnd) {
+			dimmer = 1.0f - ((distance - distantLightFadeStart) / (distantLightFadeEnd - distantLightFadeStart));
+		} else {
+			dimmer = 0.0f;
+		}
 
-					if (clusteredLights) {
-						auto averageRadius = clusteredLight.radius / (float)clusteredLights;
-						float radiusDiff = abs(averageRadius - radius);
+		light.color *= dimmer;
 
-						auto averagePosition = clusteredLight.positionWS[0].data / (float)clusteredLights;
-						float positionDiff = positionWS.GetDistance({ averagePosition.x, averagePosition.y, averagePosition.z });
+		if ((light.color.x + light.color.y + light.color.z) <= 1e-4 || light.radius <= 1e-4)
+			return 0;
 
-						if ((radiusDiff + positionDiff) > settings.ParticleLightsOptimisationClusterRadius || !settings.EnableParticleLightsOptimization) {
-							clusteredLight.radius /= (float)clusteredLights;
-							clusteredLight.positionWS[0].data /= (float)clusteredLights;
-							clusteredLight.positionWS[1].data = clusteredLight.positionWS[0].data;
-							if (eyeCount == 2) {
-								clusteredLight.positionWS[1].data.x += eyePositionOffset.x / (float)clusteredLights;
-								clusteredLight.positionWS[1].data.y += eyePositionOffset.y / (float)clusteredLights;
-								clusteredLight.positionWS[1].data.z += eyePositionOffset.z / (float)clusteredLights;
-							}
+		light.firstPersonShadow = bsLight == firstPersonLight || bsLight == thirdPersonLight || niLight == refLight || niLight == magicLight;
+		*o_light = light;
+		return 1;
+	};
 
-							AddCachedParticleLights(lightsData, clusteredLight);
+	// Process particle lights
 
-							clusteredLights = 0;
-							clusteredLight.color = { 0, 0, 0 };
-							clusteredLight.radius = 0;
-							clusteredLight.positionWS[0].data = { 0, 0, 0 };
-						}
-					}
+	auto gatherParticleLights = [&](const ParticleLightSource& a_source, GatherScratch& a_scratch, LightData* o_lights) -> uint32_t {
+		const auto& info = *a_source.info;
+		uint32_t written = 0;
 
-					float alpha = particleLight.second.color.alpha * particleData->GetParticlesRuntimeData().color[p].alpha;
-					float3 color;
-					color.x = particleLight.second.color.red * particleData->GetParticlesRuntimeData().color[p].red;
-					color.y = particleLight.second.color.green * particleData->GetParticlesRuntimeData().color[p].green;
-					color.z = particleLight.second.color.blue * particleData->GetParticlesRuntimeData().color[p].blue;
-					clusteredLight.color += Saturation(color, settings.ParticleLightsSaturation) * alpha * settings.ParticleBrightness;
+		if (!a_source.particleSystem) {
+			// Process billboard
+			LightData light{};
 
-					clusteredLight.radius += radius * settings.ParticleRadius * particleLight.second.config.radiusMult;
-					clusteredLight.positionWS[0].data.x += positionWS.x;
-					clusteredLight.positionWS[0].data.y += positionWS.y;
-					clusteredLight.positionWS[0].data.z += positionWS.z;
+			light.color.x = info.color.red;
+			light.color.y = info.color.green;
+			light.color.z = info.color.blue;
 
-					clusteredLights++;
-				}
+			light.color = Saturation(light.color, settings.ParticleLightsSaturation);
 
-			} else {
-				// Process billboard
-				LightData light{};
+			light.color *= info.color.alpha * settings.BillboardBrightness;
+			light.radius = a_source.geometry->worldBound.radius * settings.BillboardRadius * info.config.radiusMult;
 
-				light.color.x = particleLight.second.color.red;
-				light.color.y = particleLight.second.color.green;
-				light.color.z = particleLight.second.color.blue;
+			auto position = a_source.geometry->world.translate;
 
-				light.color = Saturation(light.color, settings.ParticleLightsSaturation);
+			SetLightPosition(light, position);  // Light is complete for both eyes by now
+
+			if (PrepareParticleLight(light, &info.config, a_source.flicker, timer))
+				o_lights[written++] = light;
+			return written;
+		}
 
-				light.color *= particleLight.second.color.alpha * settings.BillboardBrightness;
-				light.radius = particleLight.first->worldBound.radius * settings.BillboardRadius * particleLight.second.config.radiusMult;
+		// Process BSGeometry
+		auto particleSystem = a_source.particleSystem;
+		auto particleData = particleSystem->GetParticleRuntimeData().particleData.get();
 
-				auto position = particleLight.first->world.translate;
+		a_scratch.inputs.clear();
 
-				SetLightPosition(light, position);  // Light is complete for both eyes by now
+		auto numVertices = std::min<uint32_t>(particleData->GetActiveVertexCount(), a_source.particleCount);
+		for (std::uint32_t p = 0; p < numVertices; p++) {
+			float radius = particleData->GetParticlesRuntimeData().sizes[p] * 70.0f;
 
-				AddCachedParticleLights(lightsData, light, &particleLight.second.config, particleLight.first, State::GetSingleton()->timer);
+			auto initialPosition = particleData->GetParticlesRuntimeData().positions[p];
+			if (!particleSystem->GetParticleSystemRuntimeData().isWorldspace) {
+				// Detect first-person meshes
+				if ((a_source.geometry->GetModelData().modelBound.radius * a_source.geometry->world.scale) != a_source.geometry->worldBound.radius)
+					initialPosition += a_source.geometry->worldBound.center;
+				else
+					initialPosition += a_source.geometry->world.translate;
 			}
+
+			float alpha = info.color.alpha * particleData->GetParticlesRuntimeData().color[p].alpha;
+			float3 color;
+			color.x = info.color.red * particleData->GetParticlesRuntimeData().color[p].red;
+			color.y = info.color.green * particleData->GetParticlesRuntimeData().color[p].green;
+			color.z = info.color.blue * particleData->GetParticlesRuntimeData().color[p].blue;
+
+			ParticleLightClustering::Light& input = a_scratch.inputs.emplace_back();
+			input.position = { initialPosition.x, initialPosition.y, initialPosition.z };
+			input.radius = radius * settings.ParticleRadius * info.config.radiusMult;
+			input.color = Saturation(color, settings.ParticleLightsSaturation) * alpha * settings.ParticleBrightness;
 		}
 
-		if (clusteredLights) {
-			clusteredLight.radius /= (float)clusteredLights;
-			clusteredLight.positionWS[0].data /= (float)clusteredLights;
-			clusteredLight.positionWS[1].data = clusteredLight.positionWS[0].data;
-			if (eyeCount == 2) {
-				clusteredLight.positionWS[1].data.x += eyePositionOffset.x / (float)clusteredLights;
-				clusteredLight.positionWS[1].data.y += eyePositionOffset.y / (float)clusteredLights;
-				clusteredLight.positionWS[1].data.z += eyePositionOffset.z / (float)clusteredLights;
-			}
-			AddCachedParticleLights(lightsData, clusteredLight);
+		std::span<const ParticleLightClustering::Light> systemLights = a_scratch.inputs;
+		if (settings.EnableParticleLightsOptimization) {
+			a_scratch.clustered.clear();
+			a_scratch.clustering.Build(a_scratch.inputs, (float)settings.ParticleLightsOptimisationClusterRadius, settings.ParticleLightsOptimisationMaxLights, a_scratch.clustered);
+			systemLights = a_scratch.clustered;
+		}
+
+		for (const auto& systemLight : systemLights) {
+			LightData& light = o_lights[written];
+			light = {};
+			light.color = systemLight.color;
+			light.radius = systemLight.radius;
+			SetLightPosition(light, { systemLight.position.x, systemLight.position.y, systemLight.position.z });
+			if (PrepareParticleLight(light))
+				written++;
+		}
+		return written;
+	};
+
+	// Sources are handed out one at a time so a few large particle systems do not serialise on one thread
+
+	auto gatherStart = std::chrono::high_resolution_clock::now();
+
+	const uint threadCount = std::clamp(gatherThreadCount, 1u, 16u);
+	if (gatherScratch.size() < threadCount)
+		gatherScratch.resize(threadCount);
+	for (auto& scratch : gatherScratch)
+		scratch.clustering.stats = {};
+
+	std::atomic<uint32_t> nextSource = 0;
+	auto gather = [&](GatherScratch& a_scratch) {
+		for (uint32_t i = nextSource++; i < sourceCount; i = nextSource++) {
+			LightData* slab = gatherSlab.data() + gatherOffsets[i];
+			gatherCounts[i] = i < pointLightCount ? gatherPointLight(i, slab) : gatherParticleLights(particleLightSources[i - pointLightCount], a_scratch, slab);
 		}
+	};
+
+	if (threadCount > 1 && sourceCount > 1) {
+		if (gatherPool.get_thread_count() != threadCount - 1)
+			gatherPool.reset(threadCount - 1);
+		for (uint t = 1; t < threadCount; t++)
+			gatherPool.push_task([&gather, &scratch = gatherScratch[t]] { gather(scratch); });
+		gather(gatherScratch[0]);
+		gatherPool.wait_for_tasks();
+	} else {
+		gather(gatherScratch[0]);
+	}
+
+	// Compact in source order
+
+	eastl::vector<LightData> lightsData{};
+	lightsData.reserve(lightCapacity);
+
+	for (uint32_t i = 0; i < pointLightCount; i++) {
+		if (gatherCounts[i])
+			lightsData.push_back(gatherSlab[gatherOffsets[i]]);
+	}
+
+	cachedParticleLights.clear();
+	for (uint32_t i = pointLightCount; i < sourceCount; i++) {
+		for (uint32_t k = 0; k < gatherCounts[i]; k++)
+			AddCachedParticleLights(lightsData, gatherSlab[gatherOffsets[i] + k]);
+	}
+
+	// Overwriting the oldest slot frees the grid replaced last frame; the one replaced now stays alive for queries in flight
+	particleLightGridIndex = (particleLightGridIndex + 1) % particleLightGrids.size();
+	auto& grid = particleLightGrids[particleLightGridIndex];
+	grid = std::make_unique<const ParticleLightGrid>(std::move(cachedParticleLights));
+	particleLightGrid.store(grid.get(), std::memory_order_release);
+
+	gatherMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - gatherStart).count();
+
+	particleLightClusteringStats = {};
+	for (uint t = 0; t < threadCount; t++)
+		particleLightClusteringStats.Add(gatherScratch[t].clustering.stats);
+
+	// Keep the most important lights within the budget, and order them by importance so that a cluster
+	// that fills up keeps its strongest lights
+
+	droppedLights = 0;
+	if (lightsData.size() > CLUSTER_MAX_LIGHTS) {
+		lightImportance.resize(lightsData.size());
+		for (std::uint32_t i = 0; i < lightsData.size(); i++)
+			lightImportance[i] = { GetLightImportance(lightsData[i]), i };
+
+		auto moreImportant = [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+		if (lightImportance.size() > MAX_LIGHTS) {
+			std::nth_element(lightImportance.begin(), lightImportance.begin() + MAX_LIGHTS, lightImportance.end(), moreImportant);
+			droppedLights = (std::uint32_t)lightImportance.size() - MAX_LIGHTS;
+			lightImportance.resize(MAX_LIGHTS);
+		}
+		std::sort(lightImportance.begin(), lightImportance.end(), moreImportant);
+
+		eastl::vector<LightData> sortedLights;
+		sortedLights.reserve(lightImportance.size());
+		for (const auto& entry : lightImportance)
+			sortedLights.push_back(lightsData[entry.second]);
+		lightsData.swap(sortedLights);
 	}
 
 	static auto& context = State::GetSingleton()->context;
@@ -930,7 +1161,7 @@ void LightLimitFix::UpdateLights()
 
 		static float _near = 0.0f, _far = 0.0f, _fov = 0.0f, _lightsNear = 0.0f, _lightsFar = 0.0f;
 		if (fabs(_near - accumulator->kCamera->GetRuntimeData2().viewFrustum.fNear) > 1e-4 || fabs(_far - accumulator->kCamera->GetRuntimeData2().viewFrustum.fFar) > 1e-4 || fabs(_fov - fov) > 1e-4 || fabs(_lightsNear - lightsNear) > 1e-4 || fabs(_lightsFar - lightsFar) > 1e-4) {
-			LightBuildingCB updateData{};
+			auto& updateData = lightBuildingData;
 			updateData.InvProjMatrix[0] = DirectX::XMMatrixInverse(nullptr, projMatrixUnjittered);
 			if (eyeCount == 1)
 				updateData.InvProjMatrix[1] = updateData.InvProjMatrix[0];
@@ -962,7 +1193,9 @@ void LightLimitFix::UpdateLights()
 	}
 
 	{
-		lightCount = std::min((uint)lightsData.size(), MAX_LIGHTS);
+		lightCount = (uint)lightsData.size();
+		if (lightCount > lightCapacity)
+			CreateLightBuffer(std::bit_ceil(lightCount));
 
 		D3D11_MAPPED_SUBRESOURCE mapped;
 		DX::ThrowIfFailed(context->Map(lights->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
@@ -997,6 +1230,76 @@ void LightLimitFix::UpdateLights()
 
 	ID3D11UnorderedAccessView* null_uavs[3] = { nullptr };
 	context->CSSetUnorderedAccessViews(0, 3, null_uavs, nullptr);
+	BindingCache::GetSingleton()->InvalidateShaderResources();
+
+	// the light grid readback only feeds the statistics panel
+	if (std::exchange(clusterStatisticsVisible, false))
+		ReadClusterOccupancy();
+
+	if (validateClusters) {
+		validateClusters = false;
+		auto result = ClusterReference::Validate(context, lightBuildingData, eyeCount, { lightsData.data(), lightCount },
+			clusters->resource.get(), lightList->resource.get(), lightGrid->resource.get());
+		clusterValidationStatus = std::format("Cluster Validation : {} AABB / {} light grid mismatches, CPU cull {:.2f} ms",
+			result.clusterMismatches, result.lightGridMismatches, result.cullMs);
+	}
+}
+
+float LightLimitFix::GetLightImportance(const LightData& a_light)
+{
+	// Luminance times the light's approximate share of the screen, treating it as a sphere of its radius
+	float grey = a_light.color.Dot(float3(0.3f, 0.59f, 0.11f));
+	float radiusSq = a_light.radius * a_light.radius;
+	float distanceSq = a_light.positionWS[0].data.LengthSquared();
+	return grey * std::min(radiusSq / std::max(distanceSq, 1.0f), 1.0f);
+}
+
+void LightLimitFix::ReadClusterOccupancy()
+{
+	auto& context = State::GetSingleton()->context;
+
+	if (!lightGridReadback) {
+		D3D11_BUFFER_DESC desc;
+		lightGrid->resource->GetDesc(&desc);
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+		DX::ThrowIfFailed(State::GetSingleton()->device->CreateBuffer(&desc, nullptr, lightGridReadback.put()));
+	}
+
+	// Read the copy made on an earlier frame without waiting, and start a new one once it has been read
+	if (lightGridReadbackPending) {
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(context->Map(lightGridReadback.get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+			return;
+
+		clusterOverflowSlots = 0;
+		clusterOccupancy = {};
+		auto cells = static_cast<const LightGrid*>(mapped.pData);
+		for (uint i = 0; i < CLUSTER_COUNT; i++) {
+			uint total = cells[i].totalLightCount;
+			clusterOverflowSlots += total - std::min(total, CLUSTER_MAX_LIGHTS);
+			if (total == 0)
+				clusterOccupancy[0]++;
+			else if (total < 16)
+				clusterOccupancy[1]++;
+			else if (total < 32)
+				clusterOccupancy[2]++;
+			else if (total < 64)
+				clusterOccupancy[3]++;
+			else if (total < CLUSTER_MAX_LIGHTS)
+				clusterOccupancy[4]++;
+			else
+				clusterOccupancy[5]++;
+		}
+		context->Unmap(lightGridReadback.get(), 0);
+		lightGridReadbackPending = false;
+	}
+
+	context->CopyResource(lightGridReadback.get(), lightGrid->resource.get());
+	lightGridReadbackPending = true;
 }
 
 bool LightLimitFix::HasShaderDefine(RE::BSShader::Type shaderType)
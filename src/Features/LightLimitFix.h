@@ -1,13 +1,16 @@
 #pragma once
 #include <DirectXMath.h>
+#include <PerlinNoise.hpp>
 #include <d3d11.h>
 
+#include "BS_thread_pool.hpp"
 #include "Buffer.h"
 #include "Util.h"
-#include <shared_mutex>
 
 #include "Feature.h"
 #include "ShaderCache.h"
+#include <Features/LightLimitFix/ParticleLightClustering.h>
+#include <Features/LightLimitFix/ParticleLightGrid.h>
 #include <Features/LightLimitFix/ParticleLights.h>
 
 struct LightLimitFix : Feature
@@ -55,7 +58,8 @@ public:
 	{
 		uint offset;
 		uint lightCount;
-		float pad0[2];
+		uint totalLightCount;  // intersecting lights before the cluster cap
+		float pad0;
 	};
 
 	struct alignas(16) LightBuildingCB
@@ -92,15 +96,22 @@ public:
 
 	StrictLightData strictLightDataTemp;
 
-	struct CachedParticleLight
-	{
-		float grey;
-		RE::NiPoint3 position;
-		float radius;
-	};
+	using CachedParticleLight = ParticleLightGrid::Light;
 
 	std::unique_ptr<Buffer> perPass = nullptr;
+
+	// Ring of strict light sets; each draw binds a single-element view of the slot holding its set.
+	// Slots are appended with WRITE_NO_OVERWRITE and identical sets share a slot until the ring wraps.
 	std::unique_ptr<Buffer> strictLightData = nullptr;
+	std::vector<winrt::com_ptr<ID3D11ShaderResourceView>> strictLightViews;
+	ankerl::unordered_dense::map<uint64_t, uint32_t> strictLightSlots;
+	uint32_t strictLightRingPosition = 0;
+	uint32_t boundStrictLightSlot = UINT32_MAX;
+	bool strictLightNoOverwrite = false;
+	uint32_t strictLightDraws = 0;
+	uint32_t strictLightUploads = 0;
+	uint32_t strictLightDrawsLastFrame = 0;
+	uint32_t strictLightUploadsLastFrame = 0;
 
 	bool rendered = false;
 	bool boundViews = false;
@@ -119,6 +130,23 @@ public:
 	eastl::unique_ptr<Buffer> lightGrid = nullptr;
 
 	std::uint32_t lightCount = 0;
+	std::uint32_t lightCapacity = 0;
+
+	// Lights cut by the light budget, light-cluster pairs that did not fit a full cluster (one light
+	// can overflow many clusters), and clusters bucketed by how many lights intersect them:
+	// empty, 1-15, 16-31, 32-63, 64-127, and full
+	std::uint32_t droppedLights = 0;
+	std::uint32_t clusterOverflowSlots = 0;
+	std::array<std::uint32_t, 6> clusterOccupancy{};
+	winrt::com_ptr<ID3D11Buffer> lightGridReadback;
+	bool lightGridReadbackPending = false;
+	bool clusterStatisticsVisible = false;  // set while the statistics panel is drawn
+
+	std::vector<std::pair<float, std::uint32_t>> lightImportance;
+
+	LightBuildingCB lightBuildingData{};
+	bool validateClusters = false;
+	std::string clusterValidationStatus;
 
 	struct ParticleLightInfo
 	{
@@ -129,6 +157,53 @@ public:
 	eastl::hash_map<RE::BSGeometry*, ParticleLightInfo> queuedParticleLights;
 	eastl::hash_map<RE::BSGeometry*, ParticleLightInfo> particleLights;
 
+	ParticleLightClustering::Stats particleLightClusteringStats;
+
+	// Noise generators for a flickering billboard, seeded from its geometry pointer. Seeding shuffles a
+	// permutation table per generator, so they are kept for as long as the geometry keeps emitting.
+	struct FlickerState
+	{
+		explicit FlickerState(std::uint32_t a_seed) :
+			movement{ siv::PerlinNoise{ a_seed }, siv::PerlinNoise{ a_seed + 1 }, siv::PerlinNoise{ a_seed + 2 } },
+			intensity{ a_seed + 3 } {}
+
+		siv::PerlinNoise movement[3];
+		siv::PerlinNoise intensity;
+		uint32_t lastUsed = 0;
+	};
+
+	ankerl::unordered_dense::map<RE::BSGeometry*, std::unique_ptr<FlickerState>> flickerStates;
+	uint32_t flickerFrame = 0;
+	uint32_t flickerStatesCreated = 0;
+
+	// Light gathering runs as jobs over point lights and particle sources. Each source owns a fixed range
+	// of the slab and records how many lights it wrote, and the ranges are compacted in source order so the
+	// result matches a serial gather.
+	struct ParticleLightSource
+	{
+		RE::BSGeometry* geometry;
+		const ParticleLightInfo* info;
+		RE::NiParticleSystem* particleSystem;  // nullptr for billboards
+		uint32_t particleCount;
+		const FlickerState* flicker;
+	};
+
+	struct GatherScratch
+	{
+		ParticleLightClustering clustering;
+		std::vector<ParticleLightClustering::Light> inputs;
+		std::vector<ParticleLightClustering::Light> clustered;
+	};
+
+	BS::thread_pool gatherPool{ 1 };
+	uint gatherThreadCount = std::clamp(std::thread::hardware_concurrency() / 4, 1u, 4u);  // including the render thread
+	std::vector<GatherScratch> gatherScratch;
+	std::vector<ParticleLightSource> particleLightSources;
+	std::vector<LightData> gatherSlab;
+	std::vector<uint32_t> gatherOffsets;
+	std::vector<uint32_t> gatherCounts;
+	double gatherMilliseconds = 0.0;
+
 	RE::NiPoint3 eyePositionCached[2]{};
 	Matrix viewMatrixCached[2]{};
 	Matrix viewMatrixInverseCached[2]{};
@@ -145,16 +220,22 @@ public:
 
 	virtual void DrawSettings();
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void PostPostLoad() override;
 	virtual void DataLoaded() override;
 
 	float CalculateLightDistance(float3 a_lightPosition, float a_radius);
-	void AddCachedParticleLights(eastl::vector<LightData>& lightsData, LightLimitFix::LightData& light, ParticleLights::Config* a_config = nullptr, RE::BSGeometry* a_geometry = nullptr, double timer = 0.0f);
+	bool PrepareParticleLight(LightLimitFix::LightData& light, const ParticleLights::Config* a_config = nullptr, const FlickerState* a_flicker = nullptr, double timer = 0.0f);
+	void AddCachedParticleLights(eastl::vector<LightData>& lightsData, const LightLimitFix::LightData& light);
 	void SetLightPosition(LightLimitFix::LightData& a_light, RE::NiPoint3 a_initialPosition, bool a_cached = true);
 	void UpdateLights();
+	void CreateLightBuffer(std::uint32_t a_capacity);
+	void ReadClusterOccupancy();
 	void Bind();
 
+	static float GetLightImportance(const LightData& a_light);
+
 	static inline float3 Saturation(float3 color, float saturation);
 	static inline bool IsValidLight(RE::BSLight* a_light);
 	static inline bool IsGlobalLight(RE::BSLight* a_light);
@@ -175,6 +256,7 @@ public:
 		float BillboardRadius = 1.0f;
 		bool EnableParticleLightsOptimization = true;
 		uint ParticleLightsOptimisationClusterRadius = 32;
+		uint ParticleLightsOptimisationMaxLights = 32;
 	};
 
 	float lightsNear = 0.0f;
@@ -184,6 +266,38 @@ public:
 
 	using ConfigPair = std::pair<ParticleLights::Config*, ParticleLights::GradientConfig*>;
 	std::optional<ConfigPair> GetParticleLightConfigs(RE::BSRenderPass* a_pass);
+	std::optional<ConfigPair> ResolveParticleLightConfigs(std::string_view a_sourceTexturePath, std::string_view a_greyscaleTexturePath);
+
+	// Resolved configs keyed by the interned texture path strings, including misses, so passes that are
+	// not particle lights cost a single lookup. Entries hold a reference to their strings so a key cannot
+	// be recycled for a different path while cached.
+	struct ParticleLightConfigKey
+	{
+		const char* sourceTexturePath;
+		const char* greyscaleTexturePath;
+
+		bool operator==(const ParticleLightConfigKey&) const = default;
+	};
+
+	struct ParticleLightConfigKeyHash
+	{
+		uint64_t operator()(const ParticleLightConfigKey& a_key) const noexcept
+		{
+			return ankerl::unordered_dense::hash<uint64_t>{}((uint64_t)a_key.sourceTexturePath * 31 + (uint64_t)a_key.greyscaleTexturePath);
+		}
+	};
+
+	struct ParticleLightConfigEntry
+	{
+		RE::BSFixedString sourceTexturePath;
+		RE::BSFixedString greyscaleTexturePath;
+		std::optional<ConfigPair> configs;
+	};
+
+	ankerl::unordered_dense::map<ParticleLightConfigKey, ParticleLightConfigEntry, ParticleLightConfigKeyHash> particleLightConfigCache;
+	uint32_t particleLightConfigGeneration = 0;
+	uint32_t particleLightConfigResolves = 0;
+	uint32_t particleLightConfigResolvesLastFrame = 0;
 	bool AddParticleLight(RE::BSRenderPass* a_pass, ConfigPair a_config);
 	bool CheckParticleLights(RE::BSRenderPass* a_pass, uint32_t a_technique);
 
@@ -199,11 +313,20 @@ public:
 
 	void BSLightingShader_SetupGeometry_After(RE::BSRenderPass* a_pass);
 
-	std::shared_mutex cachedParticleLightsMutex;
-	eastl::vector<CachedParticleLight> cachedParticleLights;
-	std::uint32_t particleLightsDetectionHits = 0;
-
-	float CalculateLuminance(CachedParticleLight& light, RE::NiPoint3& point);
+	// Particle lights gathered this frame, published to AI light level queries as an immutable grid.
+	// Queries read the raw pointer lock-free; each grid is owned by the ring and freed a full frame after
+	// it was replaced, by which time no query can still be using it.
+	std::vector<CachedParticleLight> cachedParticleLights;
+	std::atomic<const ParticleLightGrid*> particleLightGrid = nullptr;
+	std::array<std::unique_ptr<const ParticleLightGrid>, 3> particleLightGrids;
+	uint32_t particleLightGridIndex = 0;
+	std::atomic<std::uint32_t> particleLightsDetectionHits = 0;
+	std::atomic<std::uint32_t> particleLightQueries = 0;
+	std::atomic<std::uint32_t> particleLightsTested = 0;
+	std::uint32_t particleLightQueriesLastFrame = 0;
+	std::uint32_t particleLightsTestedLastFrame = 0;
+
+	float CalculateLuminance(const CachedParticleLight& light, const RE::NiPoint3& point);
 	void AddParticleLightLuminance(RE::NiPoint3& targetPosition, int& numHits, float& lightLevel);
 
 	struct Hooks
@@ -1,6 +1,7 @@
 #include "ScreenSpaceShadows.h"
 
 #include "State.h"
+#include "BindingCache.h"
 #include "Util.h"
 
 using RE::RENDER_TARGETS;
@@ -419,6 +420,8 @@ void ScreenSpaceShadows::ModifyLighting(const RE::BSShader*, const uint32_t)
 			context->CSSetUnorderedAccessViews(0, 1, &old.uav, nullptr);
 			if (old.uav)
 				old.uav->Release();
+
+			BindingCache::GetSingleton()->InvalidateShaderResources();
 		}
 
 		PerPass data{};
@@ -430,7 +433,7 @@ void ScreenSpaceShadows::ModifyLighting(const RE::BSShader*, const uint32_t)
 			ID3D11ShaderResourceView* views[2]{};
 			views[0] = shadowMask.depthSRV;
 			views[1] = screenSpaceShadowsTexture->srv.get();
-			context->PSSetShaderResources(20, ARRAYSIZE(views), views);
+			BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 20, ARRAYSIZE(views), views);
 		}
 	} else {
 		PerPass data{};
@@ -440,7 +443,7 @@ void ScreenSpaceShadows::ModifyLighting(const RE::BSShader*, const uint32_t)
 
 	ID3D11Buffer* buffers[1]{};
 	buffers[0] = perPass->CB();
-	context->PSSetConstantBuffers(5, ARRAYSIZE(buffers), buffers);
+	BindingCache::GetSingleton()->SetConstantBuffers(BindingCache::Stage::Pixel, 5, ARRAYSIZE(buffers), buffers);
 
 	context->PSSetSamplers(14, 1, &computeSampler);
 }
@@ -460,6 +463,18 @@ void ScreenSpaceShadows::Draw(const RE::BSShader* shader, const uint32_t descrip
 	}
 }
 
+bool ScreenSpaceShadows::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Grass:
+	case RE::BSShader::Type::DistantTree:
+	case RE::BSShader::Type::Lighting:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void ScreenSpaceShadows::Load(json& o_json)
 {
 	if (o_json[GetName()].is_object())
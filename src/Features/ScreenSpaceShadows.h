@@ -83,6 +83,7 @@ struct ScreenSpaceShadows : Feature
 
 	void ModifyLighting(const RE::BSShader* shader, const uint32_t descriptor);
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
@@ -1,6 +1,7 @@
 #include "SubsurfaceScattering.h"
 #include <Util.h>
 
+#include "BindingCache.h"
 #include "State.h"
 #include <ShaderCache.h>
 
@@ -194,6 +195,7 @@ void SubsurfaceScattering::DrawSSSWrapper(bool)
 	context->CSSetShaderResources(0, 8, srvsCS);
 	context->CSSetUnorderedAccessViews(0, 8, uavsCS, nullptr);
 	context->OMSetRenderTargets(8, views, dsv);
+	BindingCache::GetSingleton()->InvalidateShaderResources();
 
 	for (int i = 0; i < 8; i++) {
 		if (srvs[i])
@@ -321,6 +323,16 @@ void SubsurfaceScattering::Draw(const RE::BSShader* a_shader, const uint32_t)
 	}
 }
 
+bool SubsurfaceScattering::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Lighting:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void SubsurfaceScattering::SetupResources()
 {
 	{
@@ -328,21 +340,7 @@ void SubsurfaceScattering::SetupResources()
 	}
 
 	{
-		D3D11_BUFFER_DESC sbDesc{};
-		sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-		sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-		sbDesc.StructureByteStride = sizeof(PerPass);
-		sbDesc.ByteWidth = sizeof(PerPass);
-		perPass = std::make_unique<Buffer>(sbDesc);
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-		srvDesc.Buffer.FirstElement = 0;
-		srvDesc.Buffer.NumElements = 1;
-		perPass->CreateSRV(srvDesc);
+		perPass = FrameConstants::GetSingleton()->Register<PerPass>();
 	}
 
 	auto renderer = RE::BSGraphics::Renderer::GetSingleton();
@@ -475,6 +473,7 @@ void SubsurfaceScattering::OverrideFirstPersonRenderTargets()
 
 		uav = nullptr;
 		context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+		BindingCache::GetSingleton()->InvalidateShaderResources();
 	}
 
 	setRenderTargetMode[2] = RE::BSGraphics::SetRenderTargetMode::SRTM_NO_CLEAR;
@@ -503,27 +502,20 @@ void SubsurfaceScattering::BSLightingShader_SetupSkin(RE::BSRenderPass* a_pass)
 			}
 		}
 
-		static PerPass perPassData{};
+		PerPass perPassData{};
+		perPassData.ValidMaterial = validMaterial;
+		perPassData.IsBeastRace = isBeastRace;
+		perPass.Update(perPassData);
 
-		if (perPassData.ValidMaterial != (uint)validMaterial || perPassData.IsBeastRace != (uint)isBeastRace) {
-			perPassData.ValidMaterial = validMaterial;
-			perPassData.IsBeastRace = isBeastRace;
-
-			auto& context = State::GetSingleton()->context;
-
-			D3D11_MAPPED_SUBRESOURCE mapped;
-			DX::ThrowIfFailed(context->Map(perPass->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-			size_t bytes = sizeof(PerPass);
-			memcpy_s(mapped.pData, bytes, &perPassData, bytes);
-			context->Unmap(perPass->resource.get(), 0);
-		}
+		// the view is already bound; this only uploads if the data changed
+		perPass.GetSRV();
 	}
 }
 
 void SubsurfaceScattering::Bind()
 {
 	auto& context = State::GetSingleton()->context;
-	ID3D11ShaderResourceView* view = perPass->srv.get();
+	ID3D11ShaderResourceView* view = perPass.GetSRV();
 	context->PSSetShaderResources(36, 1, &view);
 	validMaterial = true;
 }
@@ -2,6 +2,7 @@
 
 #include "Buffer.h"
 #include "Feature.h"
+#include "FrameConstants.h"
 
 #define SSSS_N_SAMPLES 21
 
@@ -65,7 +66,7 @@ public:
 		uint pad0[2];
 	};
 
-	std::unique_ptr<Buffer> perPass = nullptr;
+	FrameConstants::TypedBlock<PerPass> perPass;
 
 	bool validMaterial = true;
 
@@ -98,6 +99,7 @@ public:
 	void DrawSSS();
 
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
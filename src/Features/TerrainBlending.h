@@ -34,6 +34,7 @@ public:
 	bool ValidBlendingPass(RE::BSRenderPass* a_pass);
 
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type) override { return false; }
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
@@ -1,4 +1,5 @@
 #include "WaterBlending.h"
+#include "BindingCache.h"
 #include <Util.h>
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
@@ -40,48 +41,40 @@ void WaterBlending::DrawSettings()
 void WaterBlending::Draw(const RE::BSShader* shader, const uint32_t)
 {
 	if (shader->shaderType.any(RE::BSShader::Type::Water, RE::BSShader::Type::Lighting)) {
-		auto& context = State::GetSingleton()->context;
+		auto bindingCache = BindingCache::GetSingleton();
 
 		PerPass data{};
 		data.settings = settings;
-
-		D3D11_MAPPED_SUBRESOURCE mapped;
-		DX::ThrowIfFailed(context->Map(perPass->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-		size_t bytes = sizeof(PerPass);
-		memcpy_s(mapped.pData, bytes, &data, bytes);
-		context->Unmap(perPass->resource.get(), 0);
+		perPass.Update(data);
 
 		if (shader->shaderType.any(RE::BSShader::Type::Water)) {
 			auto renderer = RE::BSGraphics::Renderer::GetSingleton();
 			ID3D11ShaderResourceView* views[2]{};
 			views[0] = renderer->GetDepthStencilData().depthStencils[RE::RENDER_TARGETS_DEPTHSTENCIL::kPOST_ZPREPASS_COPY].depthSRV;
-			views[1] = perPass->srv.get();
-			context->PSSetShaderResources(33, ARRAYSIZE(views), views);
+			views[1] = perPass.GetSRV();
+			bindingCache->SetShaderResources(BindingCache::Stage::Pixel, 33, ARRAYSIZE(views), views);
 		} else {
 			ID3D11ShaderResourceView* views[1]{};
-			views[0] = perPass->srv.get();
-			context->PSSetShaderResources(34, ARRAYSIZE(views), views);
+			views[0] = perPass.GetSRV();
+			bindingCache->SetShaderResources(BindingCache::Stage::Pixel, 34, ARRAYSIZE(views), views);
 		}
 	}
 }
 
+bool WaterBlending::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Water:
+	case RE::BSShader::Type::Lighting:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void WaterBlending::SetupResources()
 {
-	D3D11_BUFFER_DESC sbDesc{};
-	sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-	sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	sbDesc.StructureByteStride = sizeof(PerPass);
-	sbDesc.ByteWidth = sizeof(PerPass);
-	perPass = std::make_unique<Buffer>(sbDesc);
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	srvDesc.Buffer.FirstElement = 0;
-	srvDesc.Buffer.NumElements = 1;
-	perPass->CreateSRV(srvDesc);
+	perPass = FrameConstants::GetSingleton()->Register<PerPass>();
 }
 
 void WaterBlending::Load(json& o_json)
@@ -1,7 +1,7 @@
 #pragma once
 
-#include "Buffer.h"
 #include "Feature.h"
+#include "FrameConstants.h"
 #include "State.h"
 
 struct WaterBlending : Feature
@@ -34,7 +34,7 @@ public:
 
 	Settings settings;
 
-	std::unique_ptr<Buffer> perPass = nullptr;
+	FrameConstants::TypedBlock<PerPass> perPass;
 
 	virtual void SetupResources();
 	virtual inline void Reset() {}
@@ -42,6 +42,7 @@ public:
 	virtual void DrawSettings();
 
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
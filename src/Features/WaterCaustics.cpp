@@ -1,4 +1,5 @@
 #include "WaterCaustics.h"
+#include "BindingCache.h"
 #include "Util.h"
 #include <DDSTextureLoader.h>
 
@@ -22,20 +23,26 @@ void WaterCaustics::DrawSettings()
 
 void WaterCaustics::Draw(const RE::BSShader*, const uint32_t)
 {
-	auto& context = State::GetSingleton()->context;
-	context->PSSetShaderResources(70, 1, &causticsView);
+	auto bindingCache = BindingCache::GetSingleton();
+	bindingCache->SetShaderResources(BindingCache::Stage::Pixel, 70, 1, &causticsView);
 	PerPass data{};
 	data.settings = settings;
-
-	D3D11_MAPPED_SUBRESOURCE mapped;
-	DX::ThrowIfFailed(context->Map(perPass->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-	size_t bytes = sizeof(PerPass);
-	memcpy_s(mapped.pData, bytes, &data, bytes);
-	context->Unmap(perPass->resource.get(), 0);
+	perPass.Update(data);
 
 	ID3D11ShaderResourceView* views[1]{};
-	views[0] = perPass->srv.get();
-	context->PSSetShaderResources(71, ARRAYSIZE(views), views);
+	views[0] = perPass.GetSRV();
+	bindingCache->SetShaderResources(BindingCache::Stage::Pixel, 71, ARRAYSIZE(views), views);
+}
+
+bool WaterCaustics::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Lighting:
+	case RE::BSShader::Type::Water:
+		return true;
+	default:
+		return false;
+	}
 }
 
 void WaterCaustics::SetupResources()
@@ -44,21 +51,7 @@ void WaterCaustics::SetupResources()
 	auto& context = State::GetSingleton()->context;
 
 	DirectX::CreateDDSTextureFromFile(device, context, L"Data\\Shaders\\WaterCaustics\\watercaustics.dds", nullptr, &causticsView);
-	D3D11_BUFFER_DESC sbDesc{};
-	sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-	sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	sbDesc.StructureByteStride = sizeof(PerPass);
-	sbDesc.ByteWidth = sizeof(PerPass);
-	perPass = std::make_unique<Buffer>(sbDesc);
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	srvDesc.Buffer.FirstElement = 0;
-	srvDesc.Buffer.NumElements = 1;
-	perPass->CreateSRV(srvDesc);
+	perPass = FrameConstants::GetSingleton()->Register<PerPass>();
 }
 
 void WaterCaustics::Load(json& o_json)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Feature.h"
+#include "FrameConstants.h"
 #include "State.h"
 struct WaterCaustics : Feature
 {
@@ -23,7 +24,7 @@ public:
 
 	Settings settings;
 
-	std::unique_ptr<Buffer> perPass = nullptr;
+	FrameConstants::TypedBlock<PerPass> perPass;
 
 	ID3D11ShaderResourceView* causticsView;
 
@@ -39,6 +40,7 @@ public:
 	virtual void DrawSettings();
 
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
@@ -1,4 +1,5 @@
 #include "WaterParallax.h"
+#include "BindingCache.h"
 #include "State.h"
 #include "Util.h"
 
@@ -22,38 +23,28 @@ void WaterParallax::DrawSettings()
 
 void WaterParallax::Draw(const RE::BSShader*, const uint32_t)
 {
-	auto& context = State::GetSingleton()->context;
 	PerPass data{};
 	data.settings = settings;
-
-	D3D11_MAPPED_SUBRESOURCE mapped;
-	DX::ThrowIfFailed(context->Map(perPass->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-	size_t bytes = sizeof(PerPass);
-	memcpy_s(mapped.pData, bytes, &data, bytes);
-	context->Unmap(perPass->resource.get(), 0);
+	perPass.Update(data);
 
 	ID3D11ShaderResourceView* views[1]{};
-	views[0] = perPass->srv.get();
-	context->PSSetShaderResources(72, ARRAYSIZE(views), views);
+	views[0] = perPass.GetSRV();
+	BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 72, ARRAYSIZE(views), views);
 }
 
-void WaterParallax::SetupResources()
+bool WaterParallax::HasDraw(RE::BSShader::Type shaderType)
 {
-	D3D11_BUFFER_DESC sbDesc{};
-	sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-	sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	sbDesc.StructureByteStride = sizeof(PerPass);
-	sbDesc.ByteWidth = sizeof(PerPass);
-	perPass = std::make_unique<Buffer>(sbDesc);
+	switch (shaderType) {
+	case RE::BSShader::Type::Water:
+		return true;
+	default:
+		return false;
+	}
+}
 
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	srvDesc.Buffer.FirstElement = 0;
-	srvDesc.Buffer.NumElements = 1;
-	perPass->CreateSRV(srvDesc);
+void WaterParallax::SetupResources()
+{
+	perPass = FrameConstants::GetSingleton()->Register<PerPass>();
 }
 
 void WaterParallax::Load(json& o_json)
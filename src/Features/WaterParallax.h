@@ -1,6 +1,6 @@
 #pragma once
-#include "Buffer.h"
 #include "Feature.h"
+#include "FrameConstants.h"
 
 struct WaterParallax : Feature
 {
@@ -23,7 +23,7 @@ public:
 
 	Settings settings;
 
-	std::unique_ptr<Buffer> perPass = nullptr;
+	FrameConstants::TypedBlock<PerPass> perPass;
 
 	virtual inline std::string GetName() { return "Water Parallax"; }
 	virtual inline std::string GetShortName() { return "WaterParallax"; }
@@ -37,6 +37,7 @@ public:
 	virtual void DrawSettings();
 
 	virtual void Draw(const RE::BSShader* shader, const uint32_t descriptor);
+	bool HasDraw(RE::BSShader::Type shaderType) override;
 
 	virtual void Load(json& o_json);
 	virtual void Save(json& o_json);
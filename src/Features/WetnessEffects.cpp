@@ -374,14 +374,10 @@ void WetnessEffects::Draw(const RE::BSShader* shader, const uint32_t)
 			data.settings.ChaoticRippleStrength *= std::clamp(data.Raining, 0.f, 1.f);
 			data.settings.ChaoticRippleScale = 1.f / settings.ChaoticRippleScale;
 
-			D3D11_MAPPED_SUBRESOURCE mapped;
-			DX::ThrowIfFailed(context->Map(perPass->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-			size_t bytes = sizeof(PerPass);
-			memcpy_s(mapped.pData, bytes, &data, bytes);
-			context->Unmap(perPass->resource.get(), 0);
+			perPass.Update(data);
 		}
 		ID3D11ShaderResourceView* views[1]{};
-		views[0] = perPass->srv.get();
+		views[0] = perPass.GetSRV();
 		context->PSSetShaderResources(22, ARRAYSIZE(views), views);
 
 		views[0] = precipOcclusionTex->srv.get();
@@ -389,24 +385,21 @@ void WetnessEffects::Draw(const RE::BSShader* shader, const uint32_t)
 	}
 }
 
+bool WetnessEffects::HasDraw(RE::BSShader::Type shaderType)
+{
+	switch (shaderType) {
+	case RE::BSShader::Type::Lighting:
+	case RE::BSShader::Type::Grass:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void WetnessEffects::SetupResources()
 {
 	{
-		D3D11_BUFFER_DESC sbDesc{};
-		sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-		sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-		sbDesc.StructureByteStride = sizeof(PerPass);
-		sbDesc.ByteWidth = sizeof(PerPass);
-		perPass = std::make_unique<Buffer>(sbDesc);
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-		srvDesc.Buffer.FirstElement = 0;
-		srvDesc.Buffer.NumElements = 1;
-		perPass->CreateSRV(srvDesc);
+		perPass = FrameConstants::GetSingleton()->Register<PerPass>();
 	}
 
 	{
@@ -0,0 +1,47 @@
+#include "FrameConstants.h"
+
+#include "State.h"
+
+FrameConstants::Block::Block(const D3D11_BUFFER_DESC& a_desc)
+{
+	buffer = std::make_unique<Buffer>(a_desc);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = 1;
+	buffer->CreateSRV(srvDesc);
+
+	data.resize(a_desc.ByteWidth);
+}
+
+void FrameConstants::Block::Update(const void* a_data, size_t a_size)
+{
+	GetSingleton()->updateCount++;
+	if (!dirty && memcmp(data.data(), a_data, a_size) == 0)
+		return;
+	memcpy_s(data.data(), data.size(), a_data, a_size);
+	dirty = true;
+}
+
+ID3D11ShaderResourceView* FrameConstants::Block::GetSRV()
+{
+	if (dirty) {
+		dirty = false;
+		GetSingleton()->mapCount++;
+
+		auto& context = State::GetSingleton()->context;
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		DX::ThrowIfFailed(context->Map(buffer->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+		memcpy_s(mapped.pData, data.size(), data.data(), data.size());
+		context->Unmap(buffer->resource.get(), 0);
+	}
+	return buffer->srv.get();
+}
+
+void FrameConstants::Reset()
+{
+	updatesLastFrame = std::exchange(updateCount, 0);
+	mapsLastFrame = std::exchange(mapCount, 0);
+}
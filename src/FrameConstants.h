@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Buffer.h"
+
+/**
+ * Frame-scoped arena for small per-feature constant blocks bound as StructuredBuffer<T> at element 0.
+ * Features register a typed block once and write their data to it whenever it may have changed. A
+ * write only marks the block dirty when the bytes differ, and a dirty block is uploaded when its view
+ * is next requested, so a block bound on every draw is mapped once per change instead of once per draw.
+ */
+class FrameConstants
+{
+public:
+	static FrameConstants* GetSingleton()
+	{
+		static FrameConstants singleton;
+		return &singleton;
+	}
+
+	class Block
+	{
+	public:
+		Block(const D3D11_BUFFER_DESC& a_desc);
+
+		/** Copy new contents; marks the block dirty if they differ from the last write. */
+		void Update(const void* a_data, size_t a_size);
+		/** Upload the block if dirty and return its view. */
+		ID3D11ShaderResourceView* GetSRV();
+
+	private:
+		std::unique_ptr<Buffer> buffer;
+		std::vector<std::byte> data;
+		bool dirty = true;
+	};
+
+	template <class T>
+	class TypedBlock
+	{
+	public:
+		TypedBlock() = default;
+		explicit TypedBlock(Block* a_block) :
+			block(a_block) {}
+
+		void Update(const T& a_data) { block->Update(&a_data, sizeof(T)); }
+		ID3D11ShaderResourceView* GetSRV() { return block->GetSRV(); }
+
+		explicit operator bool() const { return block != nullptr; }
+
+	private:
+		Block* block = nullptr;
+	};
+
+	template <class T>
+	TypedBlock<T> Register()
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		return TypedBlock<T>(blocks.emplace_back(std::make_unique<Block>(StructuredBufferDesc<T>(1, false, true))).get());
+	}
+
+	void Reset();
+
+	// Per-frame counters; updates are what uploading on every write used to cost
+	uint32_t updateCount = 0;
+	uint32_t mapCount = 0;
+	uint32_t updatesLastFrame = 0;
+	uint32_t mapsLastFrame = 0;
+
+private:
+	std::vector<std::unique_ptr<Block>> blocks;
+};
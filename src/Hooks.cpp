@@ -96,7 +96,7 @@ void hk_BSShader_LoadShaders(RE::BSShader* shader, std::uintptr_t stream)
 			auto vertexShaderDesriptor = entry->id;
 			auto pixelShaderDescriptor = entry->id;
 			State::GetSingleton()->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
-			shaderCache.GetVertexShader(*shader, vertexShaderDesriptor);
+			shaderCache.GetVertexShader(*shader, vertexShaderDesriptor, SIE::CompilationPriority::Warmup);
 		}
 		for (const auto& entry : shader->pixelShaders) {
 			if (entry->shader && shaderCache.IsDump()) {
@@ -106,9 +106,11 @@ void hk_BSShader_LoadShaders(RE::BSShader* shader, std::uintptr_t stream)
 			auto vertexShaderDesriptor = entry->id;
 			auto pixelShaderDescriptor = entry->id;
 			State::GetSingleton()->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
-			shaderCache.GetPixelShader(*shader, pixelShaderDescriptor);
+			shaderCache.GetPixelShader(*shader, pixelShaderDescriptor, SIE::CompilationPriority::Warmup);
 		}
 	}
+	if (shaderCache.IsPrecompileFromManifest())
+		shaderCache.PrecompileFromManifest(*shader);
 	BSShaderHooks::hk_LoadShaders((REX::BSShader*)shader, stream);
 };
 
@@ -8,7 +8,9 @@
 #include "ShaderCache.h"
 #include "State.h"
 
+#include "BindingCache.h"
 #include "Feature.h"
+#include "FrameConstants.h"
 #include "Features/LightLimitFix/ParticleLights.h"
 
 #define SETTING_MENU_TOGGLEKEY "Toggle Key"
@@ -327,13 +329,15 @@ void Menu::DrawSettings()
 				ImGui::Text("Defines for Shader Compiler. Semicolon \";\" separated. Clear with space. Rebuild shaders after making change. Compute Shaders require a restart to recompile.");
 			}
 			ImGui::Spacing();
-			ImGui::SliderInt("Compiler Threads", &shaderCache.compilationThreadCount, 1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+			if (ImGui::SliderInt("Compiler Threads", &shaderCache.compilationThreadCount, 1, static_cast<int32_t>(std::thread::hardware_concurrency())))
+				shaderCache.UpdateCompilationThreads();
 			if (auto _tt = Util::HoverTooltipWrapper()) {
 				ImGui::Text(
 					"Number of threads to use to compile shaders. "
 					"The more threads the faster compilation will finish but may make the system unresponsive. ");
 			}
-			ImGui::SliderInt("Background Compiler Threads", &shaderCache.backgroundCompilationThreadCount, 1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+			if (ImGui::SliderInt("Background Compiler Threads", &shaderCache.backgroundCompilationThreadCount, 1, static_cast<int32_t>(std::thread::hardware_concurrency())))
+				shaderCache.UpdateCompilationThreads();
 			if (auto _tt = Util::HoverTooltipWrapper()) {
 				ImGui::Text(
 					"Number of threads to use to compile shaders while playing game. "
@@ -371,6 +375,17 @@ void Menu::DrawSettings()
 					"Automatically recompile shaders on file change. "
 					"Intended for developing.");
 			}
+			bool precompileFromManifest = shaderCache.IsPrecompileFromManifest();
+			if (ImGui::Checkbox("Precompile From Manifest", &precompileFromManifest)) {
+				shaderCache.SetPrecompileFromManifest(precompileFromManifest);
+			}
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text(
+					"Compile every shader recorded in the usage manifest while the game starts. "
+					"The manifest (Data\\SKSE\\Plugins\\CommunityShadersManifest.bin) records every shader drawn in previous sessions "
+					"and can be shared with a modlist so the disk cache is built before the main menu. "
+					"Requires a restart.");
+			}
 
 			if (ImGui::Button("Dump Ini Settings", { -1, 0 })) {
 				Util::DumpSettingsOptions();
@@ -399,6 +414,13 @@ void Menu::DrawSettings()
 			}
 			if (ImGui::TreeNodeEx("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
 				ImGui::Text(std::format("Shader Compiler : {}", shaderCache.GetShaderStatsString()).c_str());
+				ImGui::Text(std::format("Shader Manifest : {} permutations", shaderCache.GetShaderManifestSize()).c_str());
+				auto frameConstants = FrameConstants::GetSingleton();
+				ImGui::Text(std::format("Feature Constants : {} uploads for {} writes last frame", frameConstants->mapsLastFrame, frameConstants->updatesLastFrame).c_str());
+				auto bindingCache = BindingCache::GetSingleton();
+				ImGui::Text(std::format("Feature Bindings : {} calls for {} slots last frame", bindingCache->issuedCallsLastFrame, bindingCache->requestedSlotsLastFrame).c_str());
+				auto state = State::GetSingleton();
+				ImGui::Text(std::format("Perf Annotations : {} ({} label allocations last frame)", state->IsPerfAnnotationActive() ? "profiler attached" : "off", state->perfLabelAllocationsLastFrame).c_str());
 				ImGui::TreePop();
 			}
 		}
@@ -900,6 +922,7 @@ void Menu::ProcessInputEventQueue()
 				} else if (key == skipCompilationKey) {
 					auto& shaderCache = SIE::ShaderCache::Instance();
 					shaderCache.backgroundCompilation = true;
+					shaderCache.UpdateCompilationThreads();
 				} else if (key == effectToggleKey) {
 					auto& shaderCache = SIE::ShaderCache::Instance();
 					shaderCache.SetEnabled(!shaderCache.IsEnabled());
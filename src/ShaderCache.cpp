@@ -5,6 +5,7 @@
 #include <d3d11.h>
 #include <d3dcompiler.h>
 #include <fmt/std.h>
+#include <fstream>
 #include <wrl/client.h>
 
 #include "Feature.h"
@@ -934,15 +935,23 @@ namespace SIE
 			mapBufferConsts("PerGeometry", bufferSizes[2]);
 		}
 
-		std::wstring GetDiskPath(const std::string_view& name, uint32_t descriptor, ShaderClass shaderClass)
+		/** @brief Content-addressed disk cache key for a shader.
+		Hashes the active include closure of the source together with the full define set, profile and
+		compile flags, so edits only invalidate the permutations that can actually see them.
+		*/
+		static uint64_t GetDiskCacheKey(const std::wstring& path, const std::array<D3D_SHADER_MACRO, 64>& defines, ShaderClass shaderClass, uint32_t flags, ShaderDependencies::Closure* closure)
 		{
-			switch (shaderClass) {
-			case ShaderClass::Pixel:
-				return std::format(L"Data/ShaderCache/{}/{:X}.pso", std::wstring(name.begin(), name.end()), descriptor);
-			case ShaderClass::Vertex:
-				return std::format(L"Data/ShaderCache/{}/{:X}.vso", std::wstring(name.begin(), name.end()), descriptor);
+			std::vector<std::string> defineStrings;
+			for (const auto& def : defines) {
+				if (def.Name == nullptr)
+					break;
+				defineStrings.push_back(def.Definition != nullptr && def.Definition[0] != '\0' ? std::format("{}={}", def.Name, def.Definition) : def.Name);
 			}
-			return std::format(L"Data/ShaderCache/{}/{:X}.cso", std::wstring(name.begin(), name.end()), descriptor);
+			// '#' cannot start a macro name so these never collide with real defines
+			defineStrings.push_back(std::format("#profile={}", GetShaderProfile(shaderClass)));
+			defineStrings.push_back(std::format("#flags={:X}", flags));
+			defineStrings.push_back(std::format("#version={}", SHADER_CACHE_VERSION.string()));
+			return ShaderCache::Instance().GetSourceHash(path, std::move(defineStrings), closure);
 		}
 
 		static std::string GetShaderString(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, bool hashkey)
@@ -981,32 +990,6 @@ namespace SIE
 			}
 			const auto type = shader.shaderType.get();
 
-			// check diskcache
-			auto diskPath = GetDiskPath(shader.fxpFilename, descriptor, shaderClass);
-
-			if (!shaderBlob && useDiskCache && std::filesystem::exists(diskPath)) {
-				shaderBlob = nullptr;
-				// check build time of cache
-				auto diskCacheTime = cache.UseFileWatcher() ? std::chrono::clock_cast<std::chrono::system_clock>(std::filesystem::last_write_time(diskPath)) : system_clock::now();
-				if (cache.ShaderModifiedSince(shader.fxpFilename, diskCacheTime)) {
-					logger::debug("Diskcached shader {} older than {}", SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true), std::format("{:%Y%m%d%H%M}", diskCacheTime));
-				} else if (FAILED(D3DReadFileToBlob(diskPath.c_str(), &shaderBlob))) {
-					logger::error("Failed to load {} shader {}::{}", magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor);
-
-					if (shaderBlob != nullptr) {
-						shaderBlob->Release();
-					}
-				} else {
-					std::string str;
-					std::transform(diskPath.begin(), diskPath.end(), std::back_inserter(str), [](wchar_t c) {
-						return (char)c;
-					});
-					logger::debug("Loaded shader from {}", str);
-					cache.AddCompletedShader(shaderClass, shader, descriptor, shaderBlob);
-					return shaderBlob;
-				}
-			}
-
 			// prepare preprocessor defines
 			std::array<D3D_SHADER_MACRO, 64> defines{};
 			auto lastIndex = 0;
@@ -1039,11 +1022,27 @@ namespace SIE
 				logger::error("Failed to compile {} shader {}::{}: {} does not exist", magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor, strPath);
 				return nullptr;
 			}
+			const uint32_t flags = !State::GetSingleton()->IsDeveloperMode() ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_DEBUG;
+
+			// the closure is also recorded so the file watcher can invalidate just the dependent permutations
+			ShaderDependencies::Closure dependencies;
+			const auto diskCacheKey = GetDiskCacheKey(path, defines, shaderClass, flags, &dependencies);
+			cache.AddShaderDependencies(shaderClass, shader, descriptor, dependencies);
+
+			// check diskcache
+			if (useDiskCache) {
+				system_clock::time_point diskCacheTime;
+				if (shaderBlob = cache.ReadDiskCache(diskCacheKey, diskCacheTime); shaderBlob) {
+					logger::debug("Loaded shader {}:{}:{:X} from disk cache {:016X} compiled {}", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor, diskCacheKey, std::format("{:%Y%m%d%H%M}", diskCacheTime));
+					cache.AddCompletedShader(shaderClass, shader, descriptor, shaderBlob);
+					return shaderBlob;
+				}
+			}
+
 			logger::debug("Compiling {} {}:{}:{:X} to {}", strPath, magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor, MergeDefinesString(defines));
 
 			// compile shaders
 			ID3DBlob* errorBlob = nullptr;
-			const uint32_t flags = !State::GetSingleton()->IsDeveloperMode() ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_DEBUG;
 			const HRESULT compileResult = D3DCompileFromFile(path.c_str(), defines.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
 				GetShaderProfile(shaderClass), flags, 0, &shaderBlob, &errorBlob);
 
@@ -1082,28 +1081,10 @@ namespace SIE
 
 			// save shader to disk
 			if (useDiskCache) {
-				auto directoryPath = std::format("Data/ShaderCache/{}", shader.fxpFilename);
-				if (!std::filesystem::is_directory(directoryPath)) {
-					try {
-						std::filesystem::create_directories(directoryPath);
-					} catch (std::filesystem::filesystem_error const& ex) {
-						logger::error("Failed to create folder: {}", ex.what());
-					}
-				}
-
-				const HRESULT saveResult = D3DWriteBlobToFile(shaderBlob, diskPath.c_str(), true);
-				if (FAILED(saveResult)) {
-					std::string str;
-					std::transform(diskPath.begin(), diskPath.end(), std::back_inserter(str), [](wchar_t c) {
-						return (char)c;
-					});
-					logger::error("Failed to save shader to {}", str);
+				if (!cache.WriteDiskCache(diskCacheKey, shaderBlob)) {
+					logger::error("Failed to save shader {}:{}:{:X} to disk cache", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
 				} else {
-					std::string str;
-					std::transform(diskPath.begin(), diskPath.end(), std::back_inserter(str), [](wchar_t c) {
-						return (char)c;
-					});
-					logger::debug("Saved shader to {}", str);
+					logger::debug("Saved shader {}:{}:{:X} to disk cache", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
 				}
 			}
 			cache.AddCompletedShader(shaderClass, shader, descriptor, shaderBlob);
@@ -1231,7 +1212,7 @@ namespace SIE
 	}
 
 	RE::BSGraphics::VertexShader* ShaderCache::GetVertexShader(const RE::BSShader& shader,
-		uint32_t descriptor)
+		uint32_t descriptor, CompilationPriority priority)
 	{
 		if (shader.shaderType.get() == RE::BSShader::Type::Effect) {
 			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Lighting)) {
@@ -1245,25 +1226,19 @@ namespace SIE
 			return nullptr;
 		}
 
-		auto key = SIE::SShaderCache::GetShaderString(ShaderClass::Vertex, shader, descriptor, true);
-		if (blockedKeyIndex != -1 && !blockedKey.empty() && key == blockedKey) {
-			if (std::find(blockedIDs.begin(), blockedIDs.end(), descriptor) == blockedIDs.end()) {
-				blockedIDs.push_back(descriptor);
-				logger::debug("Skipping blocked shader {:X}:{} total: {}", descriptor, blockedKey, blockedIDs.size());
-			}
+		if (IsBlockedShader(ShaderClass::Vertex, shader, descriptor)) {
 			return nullptr;
 		}
-		{
-			std::lock_guard lockGuard(vertexShadersMutex);
-			auto& typeCache = vertexShaders[static_cast<size_t>(shader.shaderType.underlying())];
-			auto it = typeCache.find(descriptor);
-			if (it != typeCache.end()) {
-				return it->second.get();
-			}
+		if (auto cached = vertexShaders[static_cast<size_t>(shader.shaderType.underlying())].Find(descriptor)) {
+			return cached;
 		}
+		// only misses are recorded, keeping the hit path lock-free; hits were either recorded when they
+		// missed or warmed up from LoadShaders or the manifest
+		if (priority == CompilationPriority::Draw)
+			RecordShaderUsage(ShaderClass::Vertex, shader.shaderType.get(), descriptor);
 
 		if (IsAsync()) {
-			compilationSet.Add({ ShaderClass::Vertex, shader, descriptor });
+			compilationSet.Add({ ShaderClass::Vertex, shader, descriptor }, priority);
 		} else {
 			return MakeAndAddVertexShader(shader, descriptor);
 		}
@@ -1272,7 +1247,7 @@ namespace SIE
 	}
 
 	RE::BSGraphics::PixelShader* ShaderCache::GetPixelShader(const RE::BSShader& shader,
-		uint32_t descriptor)
+		uint32_t descriptor, CompilationPriority priority)
 	{
 		if (shader.shaderType.get() == RE::BSShader::Type::Effect) {
 			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Lighting)) {
@@ -1286,25 +1261,19 @@ namespace SIE
 			return nullptr;
 		}
 
-		auto key = SIE::SShaderCache::GetShaderString(ShaderClass::Pixel, shader, descriptor, true);
-		if (blockedKeyIndex != -1 && !blockedKey.empty() && key == blockedKey) {
-			if (std::find(blockedIDs.begin(), blockedIDs.end(), descriptor) == blockedIDs.end()) {
-				blockedIDs.push_back(descriptor);
-				logger::debug("Skipping blocked shader {:X}:{} total: {}", descriptor, blockedKey, blockedIDs.size());
-			}
+		if (IsBlockedShader(ShaderClass::Pixel, shader, descriptor)) {
 			return nullptr;
 		}
-		{
-			std::lock_guard lockGuard(pixelShadersMutex);
-			auto& typeCache = pixelShaders[static_cast<size_t>(shader.shaderType.underlying())];
-			auto it = typeCache.find(descriptor);
-			if (it != typeCache.end()) {
-				return it->second.get();
-			}
+		if (auto cached = pixelShaders[static_cast<size_t>(shader.shaderType.underlying())].Find(descriptor)) {
+			return cached;
 		}
+		// only misses are recorded, keeping the hit path lock-free; hits were either recorded when they
+		// missed or warmed up from LoadShaders or the manifest
+		if (priority == CompilationPriority::Draw)
+			RecordShaderUsage(ShaderClass::Pixel, shader.shaderType.get(), descriptor);
 
 		if (IsAsync()) {
-			compilationSet.Add({ ShaderClass::Pixel, shader, descriptor });
+			compilationSet.Add({ ShaderClass::Pixel, shader, descriptor }, priority);
 		} else {
 			return MakeAndAddPixelShader(shader, descriptor);
 		}
@@ -1314,28 +1283,32 @@ namespace SIE
 
 	ShaderCache::~ShaderCache()
 	{
+		// workers wait on compilationSet, which is destroyed before them
+		for (auto& worker : compilationWorkers)
+			worker.request_stop();
+		compilationWorkers.clear();
 		Clear();
 		StopFileWatcher();
 	}
 
 	void ShaderCache::Clear()
 	{
+		featureEpoch++;
+		blockedPermutations.clear();
+		{
+			std::lock_guard lock(dependencyMapMutex);
+			shaderDependencyMap.clear();
+		}
 		std::lock_guard lockGuardV(vertexShadersMutex);
 		{
 			for (auto& shaders : vertexShaders) {
-				for (auto& [id, shader] : shaders) {
-					shader->shader->Release();
-				}
-				shaders.clear();
+				shaders.Clear();
 			}
 		}
 		std::lock_guard lockGuardP(pixelShadersMutex);
 		{
 			for (auto& shaders : pixelShaders) {
-				for (auto& [id, shader] : shaders) {
-					shader->shader->Release();
-				}
-				shaders.clear();
+				shaders.Clear();
 			}
 		}
 		compilationSet.Clear();
@@ -1348,21 +1321,60 @@ namespace SIE
 		logger::debug("Clearing cache for {}", magic_enum::enum_name(a_type));
 		std::lock_guard lockGuardV(vertexShadersMutex);
 		{
-			for (auto& [id, shader] : vertexShaders[static_cast<size_t>(a_type)]) {
-				shader->shader->Release();
-			}
-			vertexShaders[static_cast<size_t>(a_type)].clear();
+			vertexShaders[static_cast<size_t>(a_type)].Clear();
 		}
 		std::lock_guard lockGuardP(pixelShadersMutex);
 		{
-			for (auto& [id, shader] : pixelShaders[static_cast<size_t>(a_type)]) {
-				shader->shader->Release();
-			}
-			pixelShaders[static_cast<size_t>(a_type)].clear();
+			pixelShaders[static_cast<size_t>(a_type)].Clear();
 		}
 		compilationSet.Clear();
 	}
 
+	void ShaderCache::CollectRetiredShaders()
+	{
+		// a compiler thread holding the writer lock only delays collection to a later frame
+		auto release = [](auto& shader) { shader.shader->Release(); };
+		if (std::unique_lock lock{ vertexShadersMutex, std::try_to_lock }) {
+			for (auto& shaders : vertexShaders)
+				shaders.Collect(release);
+		}
+		if (std::unique_lock lock{ pixelShadersMutex, std::try_to_lock }) {
+			for (auto& shaders : pixelShaders)
+				shaders.Collect(release);
+		}
+	}
+
+	uint64_t ShaderCache::GetPermutationKey(ShaderClass a_class, RE::BSShader::Type a_type, uint32_t a_descriptor) const
+	{
+		// [63:42] feature epoch, [41:40] shader class, [39:32] shader type, [31:0] descriptor
+		return static_cast<uint64_t>(a_descriptor) |
+		       (static_cast<uint64_t>(a_type) & 0xFF) << 32 |
+		       (static_cast<uint64_t>(a_class) & 0x3) << 40 |
+		       static_cast<uint64_t>(featureEpoch.load(std::memory_order_relaxed)) << 42;
+	}
+
+	bool ShaderCache::IsBlockedShader(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor)
+	{
+		if (blockedKeyIndex == (uint)-1 || blockedKey.empty())
+			return false;
+
+		// the define string is only built once per permutation while blocking is active
+		auto permutationKey = GetPermutationKey(a_class, a_shader.shaderType.get(), a_descriptor);
+		auto it = blockedPermutations.find(permutationKey);
+		if (it == blockedPermutations.end()) {
+			auto key = SIE::SShaderCache::GetShaderString(a_class, a_shader, a_descriptor, true);
+			it = blockedPermutations.emplace(permutationKey, key == blockedKey).first;
+		}
+		if (!it->second)
+			return false;
+
+		if (std::find(blockedIDs.begin(), blockedIDs.end(), a_descriptor) == blockedIDs.end()) {
+			blockedIDs.push_back(a_descriptor);
+			logger::debug("Skipping blocked shader {:X}:{} total: {}", a_descriptor, blockedKey, blockedIDs.size());
+		}
+		return true;
+	}
+
 	bool ShaderCache::AddCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, ID3DBlob* a_blob)
 	{
 		auto key = SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true);
@@ -1473,9 +1485,15 @@ namespace SIE
 		isDiskCache = value;
 	}
 
+	void ShaderCache::InvalidateShaderSources()
+	{
+		shaderDependencies.Clear();
+	}
+
 	void ShaderCache::DeleteDiskCache()
 	{
 		std::scoped_lock lock{ compilationSet.compilationMutex };
+		shaderPack.Close();
 		try {
 			std::filesystem::remove_all(L"Data/ShaderCache");
 			logger::info("Deleted disk cache");
@@ -1504,8 +1522,84 @@ namespace SIE
 		if (valid) {
 			logger::info("Using disk cache");
 		} else {
-			DeleteDiskCache();
+			// entries are content-addressed, so only shaders whose sources or defines changed will miss
+			logger::info("Disk cache info changed; affected shaders will be recompiled");
+		}
+		shaderPack.Open(L"Data/ShaderCache/Shaders.pack");
+	}
+
+	uint64_t ShaderCache::GetSourceHash(const std::filesystem::path& a_path, std::vector<std::string> a_defines, ShaderDependencies::Closure* a_closure)
+	{
+		return shaderDependencies.HashClosure(a_path, std::move(a_defines), a_closure);
+	}
+
+	void ShaderCache::AddShaderDependencies(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor, ShaderDependencies::Closure a_closure)
+	{
+		auto key = SIE::SShaderCache::GetShaderString(a_class, a_shader, a_descriptor, true);
+		std::lock_guard lock(dependencyMapMutex);
+		shaderDependencyMap.insert_or_assign(GetPermutationKey(a_class, a_shader.shaderType.get(), a_descriptor), ShaderDependencyRecord{ std::move(a_closure), std::move(key) });
+	}
+
+	std::vector<std::string> ShaderCache::GetDependentShaders(const std::filesystem::path& a_file)
+	{
+		ankerl::unordered_dense::set<std::string> keys;
+		std::lock_guard lock(dependencyMapMutex);
+		for (const auto& [id, record] : shaderDependencyMap) {
+			if (ShaderDependencies::Contains(record.closure, a_file))
+				keys.insert(record.key);
+		}
+		return { keys.begin(), keys.end() };
+	}
+
+	size_t ShaderCache::InvalidateDependents(const std::filesystem::path& a_file)
+	{
+		const auto dependents = GetDependentShaders(a_file);
+		logger::info("{} changed; invalidating {} shaders", a_file.string(), dependents.size());
+		if (dependents.empty())
+			return 0;
+
+		const ankerl::unordered_dense::set<std::string> affectedKeys{ dependents.begin(), dependents.end() };
+		ankerl::unordered_dense::set<uint64_t> affected;
+		{
+			std::lock_guard lock(dependencyMapMutex);
+			for (const auto& [id, record] : shaderDependencyMap) {
+				if (affectedKeys.contains(record.key))
+					affected.insert(id);
+			}
+		}
+
+		{
+			std::unique_lock lock{ mapMutex };
+			for (const auto& key : dependents) {
+				logger::debug("Invalidating {}", key);
+				shaderMap.erase(key);
+			}
+		}
+
+		for (size_t type = 0; type < static_cast<size_t>(RE::BSShader::Type::Total); type++) {
+			const auto shaderType = static_cast<RE::BSShader::Type>(type);
+			{
+				std::lock_guard lockGuard(vertexShadersMutex);
+				vertexShaders[type].EraseIf([&](uint32_t descriptor) { return affected.contains(GetPermutationKey(ShaderClass::Vertex, shaderType, descriptor)); });
+			}
+			{
+				std::lock_guard lockGuard(pixelShadersMutex);
+				pixelShaders[type].EraseIf([&](uint32_t descriptor) { return affected.contains(GetPermutationKey(ShaderClass::Pixel, shaderType, descriptor)); });
+			}
 		}
+		// processed tasks would otherwise block the affected permutations from being queued again
+		compilationSet.Invalidate(affected);
+		return affected.size();
+	}
+
+	ID3DBlob* ShaderCache::ReadDiskCache(uint64_t a_key, system_clock::time_point& a_timestamp)
+	{
+		return shaderPack.Read(a_key, a_timestamp);
+	}
+
+	bool ShaderCache::WriteDiskCache(uint64_t a_key, ID3DBlob* a_blob)
+	{
+		return shaderPack.Write(a_key, a_blob);
 	}
 
 	void ShaderCache::WriteDiskCacheInfo()
@@ -1521,7 +1615,9 @@ namespace SIE
 	ShaderCache::ShaderCache()
 	{
 		logger::debug("ShaderCache initialized with {} compiler threads", (int)compilationThreadCount);
-		compilationPool.push_task(&ShaderCache::ManageCompilationSet, this, ssource.get_token());
+		const auto workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+		for (uint32_t i = 0; i < workerCount; i++)
+			compilationWorkers.emplace_back(&ShaderCache::CompilationWorker, this, i);
 	}
 
 	bool ShaderCache::UseFileWatcher() const
@@ -1624,8 +1720,7 @@ namespace SIE
 				}
 			} else {
 				return vertexShaders[static_cast<size_t>(shader.shaderType.get())]
-				    .insert_or_assign(descriptor, std::move(newShader))
-				    .first->second.get();
+				    .InsertOrAssign(descriptor, std::move(newShader));
 			}
 		}
 		return nullptr;
@@ -1653,8 +1748,7 @@ namespace SIE
 				}
 			} else {
 				return pixelShaders[static_cast<size_t>(shader.shaderType.get())]
-				    .insert_or_assign(descriptor, std::move(newShader))
-				    .first->second.get();
+				    .InsertOrAssign(descriptor, std::move(newShader));
 			}
 		}
 		return nullptr;
@@ -1725,6 +1819,7 @@ namespace SIE
 				blockedKey = key;
 				blockedKeyIndex = (uint)targetIndex;
 				blockedIDs.clear();
+				blockedPermutations.clear();
 				logger::debug("Blocking shader ({}/{}) {}", blockedKeyIndex + 1, shaderMap.size(), blockedKey);
 				return;
 			}
@@ -1736,25 +1831,132 @@ namespace SIE
 		blockedKey = "";
 		blockedKeyIndex = (uint)-1;
 		blockedIDs.clear();
+		blockedPermutations.clear();
 		logger::debug("Stopped blocking shaders");
 	}
 
-	void ShaderCache::ManageCompilationSet(std::stop_token stoken)
+	bool ShaderCache::IsPrecompileFromManifest() const
 	{
-		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
-		while (!stoken.stop_requested()) {
-			const auto& task = compilationSet.WaitTake(stoken);
-			if (!task.has_value())
-				break;  // exit because thread told to end
-			compilationPool.push_task(&ShaderCache::ProcessCompilationSet, this, stoken, task.value());
+		return precompileFromManifest;
+	}
+
+	void ShaderCache::SetPrecompileFromManifest(bool value)
+	{
+		precompileFromManifest = value;
+	}
+
+	void ShaderCache::RecordShaderUsage(ShaderClass a_class, RE::BSShader::Type a_type, uint32_t a_descriptor)
+	{
+		const uint64_t key = static_cast<uint64_t>(a_descriptor) | static_cast<uint64_t>(a_type) << 32 | static_cast<uint64_t>(a_class) << 40;
+		std::lock_guard lock(manifestMutex);
+		if (shaderManifest.insert(key).second)
+			manifestDirty = true;
+	}
+
+	void ShaderCache::LoadShaderManifest()
+	{
+		manifestLoaded = true;
+		std::ifstream stream(ShaderManifestPath, std::ios::binary);
+		if (!stream.is_open())
+			return;
+		uint32_t magic = 0, version = 0;
+		uint64_t count = 0;
+		stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+		stream.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!stream || magic != ShaderManifestMagic || version != ShaderManifestVersion) {
+			logger::warn("Ignoring invalid shader manifest {}", ShaderManifestPath);
+			return;
 		}
+		std::vector<uint64_t> entries(static_cast<size_t>(std::min<uint64_t>(count, 1 << 20)));
+		stream.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(uint64_t));
+		entries.resize(static_cast<size_t>(stream.gcount()) / sizeof(uint64_t));
+		shaderManifest.insert(entries.begin(), entries.end());
+		logger::info("Loaded shader manifest with {} permutations", entries.size());
 	}
 
-	void ShaderCache::ProcessCompilationSet(std::stop_token stoken, SIE::ShaderCompilationTask task)
+	void ShaderCache::SaveShaderManifest()
+	{
+		std::vector<uint64_t> entries(shaderManifest.begin(), shaderManifest.end());
+		std::sort(entries.begin(), entries.end());
+		std::ofstream stream(ShaderManifestPath, std::ios::binary | std::ios::trunc);
+		const uint64_t count = entries.size();
+		stream.write(reinterpret_cast<const char*>(&ShaderManifestMagic), sizeof(ShaderManifestMagic));
+		stream.write(reinterpret_cast<const char*>(&ShaderManifestVersion), sizeof(ShaderManifestVersion));
+		stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(uint64_t));
+		if (!stream) {
+			logger::error("Failed to save shader manifest {}", ShaderManifestPath);
+			return;
+		}
+		manifestDirty = false;
+		logger::debug("Saved shader manifest with {} permutations", entries.size());
+	}
+
+	void ShaderCache::UpdateShaderManifest()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (now - lastManifestSave < ShaderManifestSaveInterval)
+			return;
+		lastManifestSave = now;
+		std::lock_guard lock(manifestMutex);
+		if (!manifestLoaded)
+			LoadShaderManifest();  // merge with earlier sessions before overwriting
+		if (manifestDirty)
+			SaveShaderManifest();
+		shaderPack.SaveUsage();
+	}
+
+	void ShaderCache::PrecompileFromManifest(const RE::BSShader& a_shader)
+	{
+		std::vector<uint64_t> entries;
+		{
+			std::lock_guard lock(manifestMutex);
+			if (!manifestLoaded)
+				LoadShaderManifest();
+			const auto type = static_cast<uint64_t>(a_shader.shaderType.get());
+			for (auto key : shaderManifest) {
+				if (((key >> 32) & 0xFF) == type)
+					entries.push_back(key);
+			}
+		}
+		logger::info("Precompiling {} {} permutations from manifest", entries.size(), magic_enum::enum_name(a_shader.shaderType.get()));
+		for (auto key : entries) {
+			const auto descriptor = static_cast<uint32_t>(key);
+			if (static_cast<ShaderClass>(key >> 40) == ShaderClass::Vertex)
+				GetVertexShader(a_shader, descriptor, CompilationPriority::Warmup);
+			else
+				GetPixelShader(a_shader, descriptor, CompilationPriority::Warmup);
+		}
+	}
+
+	size_t ShaderCache::GetShaderManifestSize()
+	{
+		std::lock_guard lock(manifestMutex);
+		return shaderManifest.size();
+	}
+
+	uint32_t ShaderCache::GetActiveCompilationThreads() const
+	{
+		return static_cast<uint32_t>(!backgroundCompilation ? compilationThreadCount : backgroundCompilationThreadCount);
+	}
+
+	void ShaderCache::UpdateCompilationThreads()
+	{
+		logger::debug("Using {} compiler threads", GetActiveCompilationThreads());
+		compilationSet.WakeAll();
+	}
+
+	void ShaderCache::CompilationWorker(std::stop_token stoken, uint32_t workerIndex)
 	{
 		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
-		task.Perform();
-		compilationSet.Complete(task);
+		while (!stoken.stop_requested()) {
+			const auto& task = compilationSet.WaitTake(stoken, workerIndex);
+			if (!task.has_value())
+				break;  // exit because thread told to end
+			task->Perform();
+			compilationSet.Complete(task.value());
+		}
 	}
 
 	ShaderCompilationTask::ShaderCompilationTask(ShaderClass aShaderClass,
@@ -1779,6 +1981,11 @@ namespace SIE
 		       (static_cast<size_t>(shaderClass) << 60);
 	}
 
+	uint64_t ShaderCompilationTask::GetPermutationKey() const
+	{
+		return ShaderCache::Instance().GetPermutationKey(shaderClass, shader.shaderType.get(), descriptor);
+	}
+
 	std::string ShaderCompilationTask::GetString() const
 	{
 		return SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true);
@@ -1789,40 +1996,89 @@ namespace SIE
 		return GetId() == other.GetId();
 	}
 
-	std::optional<ShaderCompilationTask> CompilationSet::WaitTake(std::stop_token stoken)
+	std::optional<ShaderCompilationTask> CompilationSet::WaitTake(std::stop_token stoken, uint32_t workerIndex)
 	{
 		std::unique_lock lock(compilationMutex);
 		auto& shaderCache = ShaderCache::Instance();
 		if (!conditionVariable.wait(
 				lock, stoken,
-				[this, &shaderCache]() { return !availableTasks.empty() &&
-			                                    // check against all tasks in queue to trickle the work. It cannot be the active tasks count because the thread pool itself is maximum.
-			                                    (int)shaderCache.compilationPool.get_tasks_total() <=
-			                                        (!shaderCache.backgroundCompilation ? shaderCache.compilationThreadCount : shaderCache.backgroundCompilationThreadCount); })) {
+				[this, &shaderCache, workerIndex]() { return !availableTasks.empty() &&
+			                                                 // workers beyond the active count stay parked so resizing takes effect immediately
+			                                                 workerIndex < shaderCache.GetActiveCompilationThreads(); })) {
 			/*Woke up because of a stop request. */
 			return std::nullopt;
 		}
 		if (!ShaderCache::Instance().IsCompiling()) {  // we just got woken up because there's a task, start clock
 			lastCalculation = lastReset = high_resolution_clock::now();
 		}
-		auto node = availableTasks.extract(availableTasks.begin());
-		auto& task = node.value();
+		return TakeNext();
+	}
+
+	ShaderCompilationTask CompilationSet::TakeNext()
+	{
+		const auto now = steady_clock::now();
+
+		// draw tasks that stopped being requested are no longer on screen; treat them as speculative
+		while (!drawTasks.empty() && now - drawTasks.begin()->lastRequest >= StaleDrawRequest) {
+			const auto& task = drawTasks.begin()->task;
+			availableTasks.at(task).priority = CompilationPriority::Warmup;
+			warmupQueue.push_back(task);
+			drawTasks.erase(drawTasks.begin());
+		}
+		while (!warmupQueue.empty()) {
+			auto it = availableTasks.find(warmupQueue.front());
+			if (it != availableTasks.end() && it->second.priority == CompilationPriority::Warmup)
+				break;
+			warmupQueue.pop_front();
+		}
+
+		// most recently requested draw task first, then most requested; warmup tasks age in every few takes
+		std::optional<ShaderCompilationTask> next;
+		if (!drawTasks.empty() && (warmupQueue.empty() || drawTakesInRow < MaxDrawTakesInRow)) {
+			auto best = std::prev(drawTasks.end());
+			next.emplace(best->task);
+			drawTasks.erase(best);
+			drawTakesInRow++;
+		} else {
+			next.emplace(warmupQueue.front());
+			warmupQueue.pop_front();
+			drawTakesInRow = 0;
+		}
+
+		auto node = availableTasks.extract(*next);
+		node.mapped().taken = now;
 		tasksInProgress.insert(std::move(node));
-		return task;
+		return *next;
 	}
 
-	void CompilationSet::Add(const ShaderCompilationTask& task)
+	void CompilationSet::Add(const ShaderCompilationTask& task, CompilationPriority priority)
 	{
 		std::unique_lock lock(compilationMutex);
+		const auto now = steady_clock::now();
+		if (auto availableIt = availableTasks.find(task); availableIt != availableTasks.end()) {
+			auto& pending = availableIt->second;
+			if (pending.priority == CompilationPriority::Draw)
+				drawTasks.erase(DrawEntry{ pending.lastRequest, pending.hits, task });
+			pending.lastRequest = now;
+			pending.hits++;
+			if (priority < pending.priority)
+				pending.priority = priority;  // the stale warmupQueue entry is skipped when reached
+			if (pending.priority == CompilationPriority::Draw)
+				drawTasks.insert(DrawEntry{ pending.lastRequest, pending.hits, task });
+			return;
+		}
 		auto inProgressIt = tasksInProgress.find(task);
 		auto processedIt = processedTasks.find(task);
 		if (inProgressIt == tasksInProgress.end() && processedIt == processedTasks.end() && !ShaderCache::Instance().GetCompletedShader(task)) {
-			auto [availableIt, wasAdded] = availableTasks.insert(task);
+			availableTasks.emplace(task, PendingTask{ priority, now, now });
+			if (priority == CompilationPriority::Draw)
+				drawTasks.insert(DrawEntry{ now, 1, task });
+			else
+				warmupQueue.push_back(task);
 			lock.unlock();
-			if (wasAdded) {
-				conditionVariable.notify_one();
-				totalTasks++;
-			}
+			// a parked worker could swallow notify_one
+			conditionVariable.notify_all();
+			totalTasks++;
 		}
 	}
 
@@ -1841,18 +2097,54 @@ namespace SIE
 		auto now = high_resolution_clock::now();
 		totalMs += duration_cast<milliseconds>(now - lastCalculation).count();
 		lastCalculation = now;
-		std::scoped_lock lock(compilationMutex);
+		std::unique_lock lock(compilationMutex);
+		if (auto inProgressIt = tasksInProgress.find(task); inProgressIt != tasksInProgress.end()) {
+			const auto& pending = inProgressIt->second;
+			const auto priority = static_cast<size_t>(pending.priority);
+			queueLatencyStats[priority].Add(duration<double, std::milli>(pending.taken - pending.queued).count());
+			compileTimeStats[priority].Add(duration<double, std::milli>(steady_clock::now() - pending.taken).count());
+			tasksInProgress.erase(inProgressIt);
+		}
+		if (staleTasks.erase(task)) {
+			// compiled from sources that changed mid-compile; the next compile replaces the result
+			const auto queued = steady_clock::now();
+			availableTasks.emplace(task, PendingTask{ CompilationPriority::Draw, queued, queued });
+			drawTasks.insert(DrawEntry{ queued, 1, task });
+			lock.unlock();
+			conditionVariable.notify_all();
+			totalTasks++;
+			return;
+		}
 		processedTasks.insert(task);
-		tasksInProgress.erase(task);
-		conditionVariable.notify_one();
+	}
+
+	void CompilationSet::WakeAll()
+	{
+		conditionVariable.notify_all();
+	}
+
+	void CompilationSet::Invalidate(const ankerl::unordered_dense::set<uint64_t>& a_permutationKeys)
+	{
+		std::scoped_lock lock(compilationMutex);
+		std::erase_if(processedTasks, [&](const ShaderCompilationTask& task) { return a_permutationKeys.contains(task.GetPermutationKey()); });
+		for (const auto& entry : tasksInProgress) {
+			if (a_permutationKeys.contains(entry.first.GetPermutationKey()))
+				staleTasks.insert(entry.first);
+		}
 	}
 
 	void CompilationSet::Clear()
 	{
 		std::scoped_lock lock(compilationMutex);
 		availableTasks.clear();
+		drawTasks.clear();
+		warmupQueue.clear();
 		tasksInProgress.clear();
 		processedTasks.clear();
+		staleTasks.clear();
+		drawTakesInRow = 0;
+		queueLatencyStats = {};
+		compileTimeStats = {};
 		totalTasks = 0;
 		completedTasks = 0;
 		failedTasks = 0;
@@ -1888,34 +2180,44 @@ namespace SIE
 			return fmt::format("{}/{}",
 				GetHumanTime(totalMs),
 				GetHumanTime(GetEta() + totalMs));
-		return fmt::format("{}/{} (successful/total)\tfailed: {}\tcachehits: {}\nElapsed/Estimated Time: {}/{}",
+		auto formatStats = [](const auto& a_stats) {
+			std::string result;
+			for (size_t i = 0; i < a_stats.size(); i++) {
+				const auto& stats = a_stats[i];
+				result += fmt::format("{}{}: {} avg {:.0f}ms max {:.0f}ms", i ? "\t" : "", magic_enum::enum_name(static_cast<CompilationPriority>(i)),
+					stats.count, stats.count ? stats.totalMs / stats.count : 0.0, stats.maxMs);
+			}
+			return result;
+		};
+		std::string latency;
+		std::string compileTime;
+		{
+			std::scoped_lock lock(compilationMutex);
+			latency = formatStats(queueLatencyStats);
+			compileTime = formatStats(compileTimeStats);
+		}
+		return fmt::format("{}/{} (successful/total)\tfailed: {}\tcachehits: {}\nElapsed/Estimated Time: {}/{}\nQueue latency {}\nCompile time {}",
 			(std::uint64_t)completedTasks,
 			(std::uint64_t)totalTasks,
 			(std::uint64_t)failedTasks,
 			(std::uint64_t)cacheHitTasks,
 			GetHumanTime(totalMs),
-			GetHumanTime(GetEta() + totalMs));
+			GetHumanTime(GetEta() + totalMs),
+			latency,
+			compileTime);
 	}
 
-	void UpdateListener::UpdateCache(const std::filesystem::path& filePath, SIE::ShaderCache& cache, bool& clearCache, bool& fileDone)
+	void UpdateListener::UpdateCache(const std::filesystem::path& filePath, SIE::ShaderCache& cache, bool& fileDone)
 	{
 		std::string extension = filePath.extension().string();
-		std::string parentDir = filePath.parent_path().string();
-		std::string shaderTypeString = filePath.stem().string();
-		std::chrono::time_point<std::chrono::system_clock> modifiedTime{};
-		auto shaderType = magic_enum::enum_cast<RE::BSShader::Type>(shaderTypeString, magic_enum::case_insensitive);
 		fileDone = true;
-		if (std::filesystem::exists(filePath))
-			modifiedTime = std::chrono::clock_cast<std::chrono::system_clock>(std::filesystem::last_write_time(filePath));
-		else  // if file doesn't exist, don't do anything
+		if (!std::filesystem::exists(filePath))  // if file doesn't exist, don't do anything
 			return;
-		if (!std::filesystem::is_directory(filePath) && extension.starts_with(".hlsl") && parentDir.ends_with("Shaders") && shaderType.has_value()) {  // TODO: Case insensitive checks
-			// Shader types, so only invalidate specific shader type (e.g,. Lighting)
-			cache.InsertModifiedShaderMap(shaderTypeString, modifiedTime);
-			cache.Clear(shaderType.value());
-		} else if (!std::filesystem::is_directory(filePath) && extension.starts_with(".hlsl")) {  // TODO: Case insensitive checks
-			// all other shaders, since we don't know what is using it, clear everything
-			clearCache = true;
+		if (!std::filesystem::is_directory(filePath) && extension.starts_with(".hlsl")) {  // TODO: Case insensitive checks
+			// only permutations whose active include closure contains the file are recompiled;
+			// disk cache entries are keyed by source content so stale ones are simply never hit
+			cache.InvalidateShaderSources();
+			cache.InvalidateDependents(filePath);
 		}
 		fileDone = false;
 	}
@@ -1928,21 +2230,20 @@ namespace SIE
 		while (cache.UseFileWatcher()) {
 			lock.lock();
 			if (!queue.empty() && queue.size() == lastQueueSize) {
-				bool clearCache = false;
 				for (fileAction fAction : queue) {
 					const std::filesystem::path filePath = std::filesystem::path(std::format("{}\\{}", fAction.dir, fAction.filename));
 					bool fileDone = false;
 					switch (fAction.action) {
 					case efsw::Actions::Add:
 						logger::debug("Detected Added path {}", filePath.string());
-						UpdateCache(filePath, cache, clearCache, fileDone);
+						UpdateCache(filePath, cache, fileDone);
 						break;
 					case efsw::Actions::Delete:
 						logger::debug("Detected Deleted path {}", filePath.string());
 						break;
 					case efsw::Actions::Modified:
 						logger::debug("Detected Changed path {}", filePath.string());
-						UpdateCache(filePath, cache, clearCache, fileDone);
+						UpdateCache(filePath, cache, fileDone);
 						break;
 					case efsw::Actions::Moved:
 						logger::debug("Detected Moved path {}", filePath.string());
@@ -1953,10 +2254,6 @@ namespace SIE
 					if (fileDone)
 						continue;
 				}
-				if (clearCache) {
-					cache.DeleteDiskCache();
-					cache.Clear();
-				}
 				queue.clear();
 			}
 			lastQueueSize = queue.size();
@@ -3,13 +3,17 @@
 #include <RE/B/BSShader.h>
 
 #include "BS_thread_pool.hpp"
+#include "ShaderDependencies.h"
+#include "ShaderPack.h"
 #include "efsw/efsw.hpp"
 #include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 
-static constexpr REL::Version SHADER_CACHE_VERSION = { 0, 0, 0, 20 };
+static constexpr REL::Version SHADER_CACHE_VERSION = { 0, 0, 0, 21 };
 
 using namespace std::chrono;
 
@@ -23,6 +27,13 @@ namespace SIE
 		Total,
 	};
 
+	enum class CompilationPriority
+	{
+		Draw,    // missed by a draw call; the player is looking at it
+		Warmup,  // speculative, e.g., queued from BSShader::LoadShaders
+		Total,
+	};
+
 	class ShaderCompilationTask
 	{
 	public:
@@ -37,6 +48,8 @@ namespace SIE
 		void Perform() const;
 
 		size_t GetId() const;
+		/** @brief The task's key in ShaderCache::GetPermutationKey terms. */
+		uint64_t GetPermutationKey() const;
 		std::string GetString() const;
 
 		bool operator==(const ShaderCompilationTask& other) const;
@@ -62,9 +75,21 @@ namespace SIE
 	class CompilationSet
 	{
 	public:
-		std::optional<ShaderCompilationTask> WaitTake(std::stop_token stoken);
-		void Add(const ShaderCompilationTask& task);
+		/** @brief Block until a task is available for this worker and take the highest priority one.
+		@param  workerIndex Workers at or above the active compiler thread count park until resized
+		*/
+		std::optional<ShaderCompilationTask> WaitTake(std::stop_token stoken, uint32_t workerIndex);
+		/** @brief Wake all workers, e.g., after the active compiler thread count changed. */
+		void WakeAll();
+		/** @brief Queue a task or, if it is already queued, record another request for it.
+		Requests at a higher priority promote a queued task.
+		*/
+		void Add(const ShaderCompilationTask& task, CompilationPriority priority = CompilationPriority::Draw);
 		void Complete(const ShaderCompilationTask& task);
+		/** @brief Let processed tasks for the given permutation keys be queued again.
+		Queued tasks have not read their sources yet and are kept; tasks in progress are requeued when they complete.
+		*/
+		void Invalidate(const ankerl::unordered_dense::set<uint64_t>& a_permutationKeys);
 		void Clear();
 		std::string GetHumanTime(double a_totalms);
 		double GetEta();
@@ -76,9 +101,58 @@ namespace SIE
 		std::mutex compilationMutex;
 
 	private:
-		std::unordered_set<ShaderCompilationTask> availableTasks;
-		std::unordered_set<ShaderCompilationTask> tasksInProgress;
+		struct PendingTask
+		{
+			CompilationPriority priority;
+			std::chrono::steady_clock::time_point queued;
+			std::chrono::steady_clock::time_point lastRequest;
+			std::chrono::steady_clock::time_point taken;  // handed to a worker
+			uint32_t hits = 1;
+		};
+
+		// Draw tasks ordered oldest to newest request: stale ones are at the front, the next to take at the back
+		struct DrawEntry
+		{
+			std::chrono::steady_clock::time_point lastRequest;
+			uint32_t hits;
+			ShaderCompilationTask task;
+
+			bool operator<(const DrawEntry& other) const
+			{
+				return std::tuple(lastRequest, hits, task.GetId()) < std::tuple(other.lastRequest, other.hits, other.task.GetId());
+			}
+		};
+
+		struct LatencyStats
+		{
+			uint64_t count = 0;
+			double totalMs = 0;
+			double maxMs = 0;
+
+			void Add(double a_ms)
+			{
+				count++;
+				totalMs += a_ms;
+				maxMs = std::max(maxMs, a_ms);
+			}
+		};
+
+		// a draw task not requested again within this window is no longer visible and is demoted
+		static constexpr auto StaleDrawRequest = std::chrono::seconds(2);
+		// aging: at most this many draw tasks are taken in a row while warmup tasks wait
+		static constexpr uint32_t MaxDrawTakesInRow = 4;
+
+		ShaderCompilationTask TakeNext();
+
+		std::unordered_map<ShaderCompilationTask, PendingTask> availableTasks;
+		std::set<DrawEntry> drawTasks;                              // subset of availableTasks at Draw priority
+		std::deque<ShaderCompilationTask> warmupQueue;              // FIFO of Warmup tasks; promoted entries are skipped lazily
+		std::unordered_map<ShaderCompilationTask, PendingTask> tasksInProgress;
 		std::unordered_set<ShaderCompilationTask> processedTasks;  // completed or failed
+		std::unordered_set<ShaderCompilationTask> staleTasks;      // in progress while their sources changed
+		uint32_t drawTakesInRow = 0;
+		std::array<LatencyStats, static_cast<size_t>(CompilationPriority::Total)> queueLatencyStats{};  // queued until taken
+		std::array<LatencyStats, static_cast<size_t>(CompilationPriority::Total)> compileTimeStats{};   // taken until complete
 		std::condition_variable_any conditionVariable;
 		std::chrono::steady_clock::time_point lastReset = high_resolution_clock::now();
 		std::chrono::steady_clock::time_point lastCalculation = high_resolution_clock::now();
@@ -92,6 +166,155 @@ namespace SIE
 		system_clock::time_point compileTime = system_clock::now();
 	};
 
+	/** @brief Open-addressing descriptor -> shader table with lock-free reads.
+	Writers must be serialized externally; readers (the render thread) only use acquire loads.
+	Tables are never resized in place: growth publishes a new table. Replaced tables and shaders
+	are retired rather than freed, and Collect frees them one collection later, so a lookup made
+	in the frame before a collection never touches freed memory.
+	*/
+	template <class T>
+	class ShaderLookupTable
+	{
+	public:
+		ShaderLookupTable() { Publish(std::make_unique<Table>(InitialCapacity)); }
+
+		T* Find(uint32_t a_descriptor) const
+		{
+			const Table* table = current.load(std::memory_order_acquire);
+			const size_t mask = table->capacity - 1;
+			for (size_t i = Hash(a_descriptor) & mask;; i = (i + 1) & mask) {
+				const Slot& slot = table->slots[i];
+				T* value = slot.value.load(std::memory_order_acquire);
+				if (!value)
+					return nullptr;
+				if (slot.key.load(std::memory_order_relaxed) == a_descriptor)
+					return value;
+			}
+		}
+
+		// Caller must hold the writer lock.
+		T* InsertOrAssign(uint32_t a_descriptor, std::unique_ptr<T> a_value)
+		{
+			Table* table = current.load(std::memory_order_relaxed);
+			if ((owned.size() + 1) * 2 > table->capacity) {
+				auto grown = std::make_unique<Table>(table->capacity * 2);
+				for (size_t i = 0; i < table->capacity; i++) {
+					if (T* value = table->slots[i].value.load(std::memory_order_relaxed))
+						Store(*grown, table->slots[i].key.load(std::memory_order_relaxed), value);
+				}
+				table = Publish(std::move(grown));
+			}
+			T* value = a_value.get();
+			Store(*table, a_descriptor, value);
+			auto& entry = owned[a_descriptor];
+			if (entry)
+				retiredValues.push_back(std::move(entry));
+			entry = std::move(a_value);
+			return value;
+		}
+
+		// Caller must hold the writer lock.
+		void Clear()
+		{
+			Publish(std::make_unique<Table>(InitialCapacity));
+			for (auto& entry : owned)
+				retiredValues.push_back(std::move(entry.second));
+			owned.clear();
+		}
+
+		// Caller must hold the writer lock. Rebuilds the table without the matching descriptors.
+		template <class Pred>
+		size_t EraseIf(Pred&& a_pred)
+		{
+			Table* table = current.load(std::memory_order_relaxed);
+			auto rebuilt = std::make_unique<Table>(table->capacity);
+			size_t erased = 0;
+			for (auto it = owned.begin(); it != owned.end();) {
+				if (a_pred(it->first)) {
+					retiredValues.push_back(std::move(it->second));
+					it = owned.erase(it);
+					erased++;
+				} else {
+					Store(*rebuilt, it->first, it->second.get());
+					++it;
+				}
+			}
+			if (erased)
+				Publish(std::move(rebuilt));
+			return erased;
+		}
+
+		// Caller must hold the writer lock. Frees everything retired before the previous collection;
+		// call once per frame from the render thread.
+		template <class Fn>
+		void Collect(Fn&& a_release)
+		{
+			for (size_t i = 0; i < retiredValuesBeforeCollect; i++)
+				a_release(*retiredValues[i]);
+			retiredValues.erase(retiredValues.begin(), retiredValues.begin() + retiredValuesBeforeCollect);
+			retiredValuesBeforeCollect = retiredValues.size();
+			retiredTables.erase(retiredTables.begin(), retiredTables.begin() + retiredTablesBeforeCollect);
+			retiredTablesBeforeCollect = retiredTables.size();
+		}
+
+		size_t Size() const { return owned.size(); }
+
+	private:
+		static constexpr size_t InitialCapacity = 256;
+
+		struct Slot
+		{
+			std::atomic<uint32_t> key = 0;
+			std::atomic<T*> value = nullptr;
+		};
+
+		struct Table
+		{
+			explicit Table(size_t a_capacity) :
+				capacity(a_capacity), slots(std::make_unique<Slot[]>(a_capacity)) {}
+			size_t capacity;
+			std::unique_ptr<Slot[]> slots;
+		};
+
+		static size_t Hash(uint32_t a_descriptor) { return ankerl::unordered_dense::hash<uint32_t>{}(a_descriptor); }
+
+		static void Store(Table& a_table, uint32_t a_descriptor, T* a_value)
+		{
+			const size_t mask = a_table.capacity - 1;
+			for (size_t i = Hash(a_descriptor) & mask;; i = (i + 1) & mask) {
+				Slot& slot = a_table.slots[i];
+				T* existing = slot.value.load(std::memory_order_relaxed);
+				if (!existing) {
+					slot.key.store(a_descriptor, std::memory_order_relaxed);
+					slot.value.store(a_value, std::memory_order_release);
+					return;
+				}
+				if (slot.key.load(std::memory_order_relaxed) == a_descriptor) {
+					slot.value.store(a_value, std::memory_order_release);
+					return;
+				}
+			}
+		}
+
+		Table* Publish(std::unique_ptr<Table> a_table)
+		{
+			Table* table = a_table.get();
+			if (active)
+				retiredTables.push_back(std::move(active));
+			active = std::move(a_table);
+			current.store(table, std::memory_order_release);
+			return table;
+		}
+
+		std::atomic<Table*> current = nullptr;
+		std::unique_ptr<Table> active;
+		std::vector<std::unique_ptr<Table>> retiredTables;
+		size_t retiredTablesBeforeCollect = 0;
+		ankerl::unordered_dense::map<uint32_t, std::unique_ptr<T>> owned;  // live shaders by descriptor
+		std::vector<std::unique_ptr<T>> retiredValues;
+		size_t retiredValuesBeforeCollect = 0;
+	};
+
 	class UpdateListener;
 
 	class ShaderCache
@@ -140,8 +363,34 @@ namespace SIE
 		void DeleteDiskCache();
 		void ValidateDiskCache();
 		void WriteDiskCacheInfo();
+		/** @brief Read a compiled shader blob from the packed disk cache.
+		@param  a_key The disk cache key of the shader
+		@param  a_timestamp Set to the time the blob was compiled
+		@return The blob, or nullptr if it is not cached
+		*/
+		ID3DBlob* ReadDiskCache(uint64_t a_key, system_clock::time_point& a_timestamp);
+		bool WriteDiskCache(uint64_t a_key, ID3DBlob* a_blob);
+		/** @brief Hash a shader source's active include closure with its defines; used as the disk cache key.
+		@param  a_closure Optional output of the files the shader depends on
+		*/
+		uint64_t GetSourceHash(const std::filesystem::path& a_path, std::vector<std::string> a_defines, ShaderDependencies::Closure* a_closure = nullptr);
+		/** @brief Drop parsed shader sources so the next hash re-reads them from disk. */
+		void InvalidateShaderSources();
+		/** @brief Remember which source files a compiled shader permutation depends on. */
+		void AddShaderDependencies(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor, ShaderDependencies::Closure a_closure);
+		/** @brief Shader keys (as in GetShaderString) of every known permutation that includes a file.
+		@param  a_file Path of a shader source, relative or absolute
+		*/
+		std::vector<std::string> GetDependentShaders(const std::filesystem::path& a_file);
+		/** @brief Drop only the compiled permutations whose include closure contains a file so they recompile.
+		Compilation tasks for other shaders are left queued.
+		@return Number of permutations invalidated
+		*/
+		size_t InvalidateDependents(const std::filesystem::path& a_file);
 		bool UseFileWatcher() const;
 		void SetFileWatcher(bool value);
+		bool IsPrecompileFromManifest() const;
+		void SetPrecompileFromManifest(bool value);
 
 		void StartFileWatcher();
 		void StopFileWatcher();
@@ -160,6 +409,8 @@ namespace SIE
 
 		void Clear();
 		void Clear(RE::BSShader::Type a_type);
+		/** @brief Free shaders and lookup tables retired at least one call ago; called once per frame. */
+		void CollectRetiredShaders();
 
 		bool AddCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, ID3DBlob* a_blob);
 		ID3DBlob* GetCompletedShader(const std::string a_key);
@@ -168,9 +419,9 @@ namespace SIE
 		ShaderCompilationTask::Status GetShaderStatus(const std::string a_key);
 		std::string GetShaderStatsString(bool a_timeOnly = false);
 
-		RE::BSGraphics::VertexShader* GetVertexShader(const RE::BSShader& shader, uint32_t descriptor);
+		RE::BSGraphics::VertexShader* GetVertexShader(const RE::BSShader& shader, uint32_t descriptor, CompilationPriority priority = CompilationPriority::Draw);
 		RE::BSGraphics::PixelShader* GetPixelShader(const RE::BSShader& shader,
-			uint32_t descriptor);
+			uint32_t descriptor, CompilationPriority priority = CompilationPriority::Draw);
 
 		RE::BSGraphics::VertexShader* MakeAndAddVertexShader(const RE::BSShader& shader,
 			uint32_t descriptor);
@@ -179,6 +430,19 @@ namespace SIE
 
 		static std::string GetDefinesString(RE::BSShader::Type enumType, uint32_t descriptor);
 
+		/** @brief Get the compact permutation key for a shader combo.
+		@param  a_class The ShaderClass (e.g., Vertex)
+		@param  a_type The RE::BSShader::Type of the shader
+		@param  a_descriptor The shader descriptor after ModifyShaderLookup
+		@return A 64-bit key packing class, type, descriptor and the current feature epoch
+		*/
+		uint64_t GetPermutationKey(ShaderClass a_class, RE::BSShader::Type a_type, uint32_t a_descriptor) const;
+		/** @brief Whether the shader combo matches the currently blocked shader key.
+		The define string is only generated on the first lookup of a permutation while blocking is active.
+		@return True if the shader should be skipped
+		*/
+		bool IsBlockedShader(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor);
+
 		uint64_t GetCachedHitTasks();
 		uint64_t GetCompletedTasks();
 		uint64_t GetFailedTasks();
@@ -192,9 +456,22 @@ namespace SIE
 		void InsertModifiedShaderMap(std::string a_shader, std::chrono::time_point<std::chrono::system_clock> a_time);
 		std::chrono::time_point<std::chrono::system_clock> GetModifiedShaderMapTime(std::string a_shader);
 
+		/** @brief Remember a permutation requested by a draw call for the usage manifest. */
+		void RecordShaderUsage(ShaderClass a_class, RE::BSShader::Type a_type, uint32_t a_descriptor);
+		/** @brief Save the usage manifest if new permutations were recorded since the last save. Called once per frame. */
+		void UpdateShaderManifest();
+		/** @brief Queue every manifest permutation of a shader for background compilation. */
+		void PrecompileFromManifest(const RE::BSShader& a_shader);
+		size_t GetShaderManifestSize();
+
+		/** @brief Number of compiler workers allowed to take tasks right now. */
+		uint32_t GetActiveCompilationThreads() const;
+		/** @brief Apply a change to the compiler thread counts or background mode immediately. */
+		void UpdateCompilationThreads();
+
 		int32_t compilationThreadCount = std::max(static_cast<int32_t>(std::thread::hardware_concurrency()) - 1, 1);
 		int32_t backgroundCompilationThreadCount = std::max(static_cast<int32_t>(std::thread::hardware_concurrency()) / 2, 1);
-		BS::thread_pool compilationPool{};
+		BS::thread_pool compilationPool{ 1 };  // file watcher queue; shader compiles run on compilationWorkers
 		bool backgroundCompilation = false;
 		bool menuLoaded = false;
 
@@ -302,18 +579,18 @@ namespace SIE
 		uint blockedKeyIndex = (uint)-1;  // index in shaderMap; negative value indicates disabled
 		std::string blockedKey = "";
 		std::vector<uint32_t> blockedIDs;  // more than one descriptor could be blocked based on shader hash
+		std::atomic<uint32_t> featureEpoch = 0;  // bumped whenever the cache is cleared so stale permutation keys never match
 
 	private:
 		ShaderCache();
-		void ManageCompilationSet(std::stop_token stoken);
-		void ProcessCompilationSet(std::stop_token stoken, SIE::ShaderCompilationTask task);
+		void CompilationWorker(std::stop_token stoken, uint32_t workerIndex);
 
 		~ShaderCache();
 
-		std::array<std::map<uint32_t, std::unique_ptr<RE::BSGraphics::VertexShader>>,
+		std::array<ShaderLookupTable<RE::BSGraphics::VertexShader>,
 			static_cast<size_t>(RE::BSShader::Type::Total)>
 			vertexShaders;
-		std::array<std::map<uint32_t, std::unique_ptr<RE::BSGraphics::PixelShader>>,
+		std::array<ShaderLookupTable<RE::BSGraphics::PixelShader>,
 			static_cast<size_t>(RE::BSShader::Type::Total)>
 			pixelShaders;
 
@@ -323,11 +600,35 @@ namespace SIE
 		bool isDump = false;
 		bool hideError = false;
 		bool useFileWatcher = false;
+		bool precompileFromManifest = false;
 
-		std::stop_source ssource;
-		std::mutex vertexShadersMutex;
-		std::mutex pixelShadersMutex;
+		std::vector<std::jthread> compilationWorkers;  // one per hardware thread; only the active count take tasks
+		ankerl::unordered_dense::map<uint64_t, bool> blockedPermutations;  // permutation key -> matches blockedKey
+		std::mutex vertexShadersMutex;  // serializes writers to vertexShaders; lookups are lock-free
+		std::mutex pixelShadersMutex;   // serializes writers to pixelShaders; lookups are lock-free
 		CompilationSet compilationSet;
+		ShaderPack shaderPack;
+		ShaderDependencies shaderDependencies;
+		struct ShaderDependencyRecord
+		{
+			ShaderDependencies::Closure closure;
+			std::string key;  // shaderMap key
+		};
+		ankerl::unordered_dense::map<uint64_t, ShaderDependencyRecord> shaderDependencyMap;  // permutation key -> sources
+		std::mutex dependencyMapMutex;
+
+		// usage manifest: every permutation a draw call missed, across sessions
+		static constexpr uint32_t ShaderManifestMagic = 0x464D5343;  // "CSMF"
+		static constexpr uint32_t ShaderManifestVersion = 1;
+		static constexpr auto ShaderManifestSaveInterval = std::chrono::seconds(30);
+		static constexpr const char* ShaderManifestPath = "Data\\SKSE\\Plugins\\CommunityShadersManifest.bin";
+		void LoadShaderManifest();
+		void SaveShaderManifest();
+		ankerl::unordered_dense::set<uint64_t> shaderManifest;  // ShaderClass << 40 | type << 32 | descriptor
+		std::mutex manifestMutex;
+		bool manifestLoaded = false;
+		bool manifestDirty = false;
+		std::chrono::steady_clock::time_point lastManifestSave = std::chrono::steady_clock::now();
 		std::unordered_map<std::string, ShaderCacheResult> shaderMap{};
 		std::mutex mapMutex;
 		std::unordered_map<std::string, system_clock::time_point> modifiedShaderMap{};  // hashmap when a shader source file last modified
@@ -343,7 +644,7 @@ namespace SIE
 	class UpdateListener : public efsw::FileWatchListener
 	{
 	public:
-		void UpdateCache(const std::filesystem::path& filePath, SIE::ShaderCache& cache, bool& clearCache, bool& retFlag);
+		void UpdateCache(const std::filesystem::path& filePath, SIE::ShaderCache& cache, bool& retFlag);
 		void processQueue();
 		void handleFileAction(efsw::WatchID, const std::string& dir, const std::string& filename, efsw::Action action, std::string) override;
 
@@ -0,0 +1,413 @@
+#include "ShaderDependencies.h"
+
+#include <fstream>
+
+namespace SIE
+{
+	namespace
+	{
+		constexpr int MaxIncludeDepth = 32;
+
+		std::string_view Trim(std::string_view a_text)
+		{
+			while (!a_text.empty() && std::isspace((unsigned char)a_text.front()))
+				a_text.remove_prefix(1);
+			while (!a_text.empty() && std::isspace((unsigned char)a_text.back()))
+				a_text.remove_suffix(1);
+			return a_text;
+		}
+
+		std::string_view StripLineComment(std::string_view a_text)
+		{
+			if (auto pos = a_text.find("//"); pos != std::string_view::npos)
+				a_text = a_text.substr(0, pos);
+			return Trim(a_text);
+		}
+
+		bool IsIdentifierChar(char c)
+		{
+			return std::isalnum((unsigned char)c) || c == '_';
+		}
+
+		std::string_view ReadIdentifier(std::string_view a_text)
+		{
+			size_t length = 0;
+			while (length < a_text.size() && IsIdentifierChar(a_text[length]))
+				length++;
+			return a_text.substr(0, length);
+		}
+
+		// Tri-state recursive descent over ||, &&, !, parentheses, defined() and integer literals.
+		class ConditionParser
+		{
+		public:
+			using Condition = ShaderDependencies::Condition;
+
+			ConditionParser(std::string_view a_expression, const ShaderDependencies::DefineSet& a_defined, const ShaderDependencies::DefineSet* a_unknown) :
+				text(a_expression), defined(a_defined), unknown(a_unknown) {}
+
+			Condition Parse()
+			{
+				auto result = ParseOr();
+				SkipSpace();
+				return failed || pos != text.size() ? Condition::Unknown : result;
+			}
+
+		private:
+			void SkipSpace()
+			{
+				while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+					pos++;
+			}
+
+			bool Accept(std::string_view a_token)
+			{
+				SkipSpace();
+				if (text.substr(pos, a_token.size()) == a_token) {
+					pos += a_token.size();
+					return true;
+				}
+				return false;
+			}
+
+			Condition ParseOr()
+			{
+				auto result = ParseAnd();
+				while (!failed && Accept("||")) {
+					auto rhs = ParseAnd();
+					if (result == Condition::True || rhs == Condition::True)
+						result = Condition::True;
+					else if (result == Condition::Unknown || rhs == Condition::Unknown)
+						result = Condition::Unknown;
+				}
+				return result;
+			}
+
+			Condition ParseAnd()
+			{
+				auto result = ParseUnary();
+				while (!failed && Accept("&&")) {
+					auto rhs = ParseUnary();
+					if (result == Condition::False || rhs == Condition::False)
+						result = Condition::False;
+					else if (result == Condition::Unknown || rhs == Condition::Unknown)
+						result = Condition::Unknown;
+				}
+				return result;
+			}
+
+			Condition ParseUnary()
+			{
+				SkipSpace();
+				if (pos < text.size() && text[pos] == '!' && text.substr(pos, 2) != "!=") {
+					pos++;
+					auto result = ParseUnary();
+					if (result == Condition::Unknown)
+						return result;
+					return result == Condition::True ? Condition::False : Condition::True;
+				}
+				return ParsePrimary();
+			}
+
+			Condition ParsePrimary()
+			{
+				SkipSpace();
+				if (Accept("(")) {
+					auto result = ParseOr();
+					if (!Accept(")"))
+						failed = true;
+					return result;
+				}
+
+				auto token = ReadIdentifier(text.substr(pos));
+				if (token.empty()) {
+					failed = true;
+					return Condition::Unknown;
+				}
+				pos += token.size();
+
+				if (token == "defined") {
+					bool parenthesized = Accept("(");
+					SkipSpace();
+					auto name = ReadIdentifier(text.substr(pos));
+					pos += name.size();
+					if (name.empty() || (parenthesized && !Accept(")"))) {
+						failed = true;
+						return Condition::Unknown;
+					}
+					return Defined(name);
+				}
+				if (std::isdigit((unsigned char)token.front()))
+					return token.find_first_not_of('0') == std::string_view::npos ? Condition::False : Condition::True;
+				// an undefined macro evaluates to 0; a defined one has a value we do not track
+				return Defined(token) == Condition::False ? Condition::False : Condition::Unknown;
+			}
+
+			Condition Defined(std::string_view a_name) const
+			{
+				std::string name(a_name);
+				if (unknown && unknown->contains(name))
+					return Condition::Unknown;
+				return defined.contains(name) ? Condition::True : Condition::False;
+			}
+
+			std::string_view text;
+			const ShaderDependencies::DefineSet& defined;
+			const ShaderDependencies::DefineSet* unknown;
+			size_t pos = 0;
+			bool failed = false;
+		};
+	}
+
+	std::string ShaderDependencies::GetSourceKey(const std::filesystem::path& a_path)
+	{
+		auto key = a_path.generic_string();
+		std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return c == '\\' ? '/' : (char)std::tolower(c); });
+		return std::filesystem::path(key).lexically_normal().generic_string();
+	}
+
+	std::vector<ShaderDependencies::Directive> ShaderDependencies::ParseDirectives(std::string_view a_source)
+	{
+		std::vector<Directive> directives;
+		std::string logicalLine;
+		size_t lineStart = 0;
+		while (lineStart < a_source.size()) {
+			auto lineEnd = a_source.find('\n', lineStart);
+			if (lineEnd == std::string_view::npos)
+				lineEnd = a_source.size();
+			auto line = a_source.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 1;
+
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			// join backslash continuations
+			if (!line.empty() && line.back() == '\\') {
+				logicalLine.append(line.substr(0, line.size() - 1));
+				continue;
+			}
+			logicalLine.append(line);
+
+			auto text = Trim(logicalLine);
+			if (text.starts_with('#')) {
+				text = Trim(text.substr(1));
+				auto keyword = ReadIdentifier(text);
+				auto argument = StripLineComment(text.substr(keyword.size()));
+
+				static const std::pair<std::string_view, Directive::Type> keywords[] = {
+					{ "include", Directive::Type::Include },
+					{ "define", Directive::Type::Define },
+					{ "undef", Directive::Type::Undef },
+					{ "if", Directive::Type::If },
+					{ "ifdef", Directive::Type::Ifdef },
+					{ "ifndef", Directive::Type::Ifndef },
+					{ "elif", Directive::Type::Elif },
+					{ "else", Directive::Type::Else },
+					{ "endif", Directive::Type::Endif },
+				};
+				for (const auto& [name, type] : keywords) {
+					if (keyword != name)
+						continue;
+					if (type == Directive::Type::Include) {
+						auto open = argument.find_first_of("\"<");
+						auto close = open == std::string_view::npos ? open : argument.find_first_of("\">", open + 1);
+						if (close != std::string_view::npos)
+							directives.push_back({ type, std::string(argument.substr(open + 1, close - open - 1)) });
+					} else if (type == Directive::Type::Define || type == Directive::Type::Undef || type == Directive::Type::Ifdef || type == Directive::Type::Ifndef) {
+						directives.push_back({ type, std::string(ReadIdentifier(argument)) });
+					} else {
+						directives.push_back({ type, std::string(argument) });
+					}
+					break;
+				}
+			}
+			logicalLine.clear();
+		}
+		return directives;
+	}
+
+	ShaderDependencies::Condition ShaderDependencies::EvaluateCondition(std::string_view a_expression, const DefineSet& a_defined, const DefineSet* a_unknown)
+	{
+		return ConditionParser(a_expression, a_defined, a_unknown).Parse();
+	}
+
+	std::filesystem::path ShaderDependencies::ResolveInclude(const std::string& a_include, const std::filesystem::path& a_includer, const std::filesystem::path& a_rootDirectory)
+	{
+		auto local = (a_includer.parent_path() / a_include).lexically_normal();
+		if (std::filesystem::exists(local))
+			return local;
+		return (a_rootDirectory / a_include).lexically_normal();
+	}
+
+	std::shared_ptr<const ShaderDependencies::SourceFile> ShaderDependencies::GetSource(const std::filesystem::path& a_path)
+	{
+		auto key = GetSourceKey(a_path);
+		{
+			std::shared_lock lock(sourcesMutex);
+			if (auto it = sources.find(key); it != sources.end())
+				return it->second;
+		}
+
+		auto source = std::make_shared<SourceFile>();
+		std::ifstream stream(a_path, std::ios::binary);
+		if (stream.is_open()) {
+			std::string contents{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+			source->exists = true;
+			source->contentHash = ankerl::unordered_dense::hash<std::string_view>{}(contents);
+			source->directives = ParseDirectives(contents);
+		}
+
+		std::unique_lock lock(sourcesMutex);
+		return sources.try_emplace(key, std::move(source)).first->second;
+	}
+
+	void ShaderDependencies::Walk(const std::filesystem::path& a_file, const std::filesystem::path& a_rootDirectory, WalkState& a_state, int a_depth)
+	{
+		if (a_depth > MaxIncludeDepth)
+			return;
+
+		auto source = GetSource(a_file);
+		auto key = GetSourceKey(a_file);
+		a_state.hashInput += std::format("{}:{:X};", key, source->exists ? source->contentHash : 0);
+		if (a_state.closure)
+			a_state.closure->push_back(std::move(key));
+
+		struct Branch
+		{
+			bool parentActive;
+			bool parentCertain;
+			bool taken;      // a previous branch of this #if chain was definitely taken
+			bool uncertain;  // a previous branch of this #if chain may have been taken
+			bool active;
+			bool certain;  // this branch is definitely taken, so its #define/#undef can be applied
+		};
+		std::vector<Branch> branches;
+
+		// Within a branch that may or may not be taken, a #define or #undef leaves the macro's state
+		// unknown; both arms of later conditions on it are then followed
+		auto setDefined = [&](const std::string& a_name, bool a_isDefined) {
+			const bool certain = branches.empty() || branches.back().certain;
+			if (!certain) {
+				a_state.unknown.insert(a_name);
+				return;
+			}
+			a_state.unknown.erase(a_name);
+			if (a_isDefined)
+				a_state.defined.insert(a_name);
+			else
+				a_state.defined.erase(a_name);
+		};
+
+		auto openBranch = [&](bool a_parentActive, bool a_parentCertain, Condition a_condition) {
+			branches.push_back({ a_parentActive, a_parentCertain, a_condition == Condition::True, a_condition == Condition::Unknown,
+				a_condition != Condition::False, a_parentCertain && a_condition == Condition::True });
+		};
+
+		for (const auto& directive : source->directives) {
+			const bool active = branches.empty() || branches.back().active;
+			const bool certain = branches.empty() || branches.back().certain;
+			switch (directive.type) {
+			case Directive::Type::Include:
+				if (active)
+					Walk(ResolveInclude(directive.argument, a_file, a_rootDirectory), a_rootDirectory, a_state, a_depth + 1);
+				break;
+			case Directive::Type::Define:
+				if (active)
+					setDefined(directive.argument, true);
+				break;
+			case Directive::Type::Undef:
+				if (active)
+					setDefined(directive.argument, false);
+				break;
+			case Directive::Type::If:
+			case Directive::Type::Ifdef:
+			case Directive::Type::Ifndef:
+				{
+					auto condition = Condition::False;
+					if (active) {
+						if (directive.type == Directive::Type::If)
+							condition = EvaluateCondition(directive.argument, a_state.defined, &a_state.unknown);
+						else if (a_state.unknown.contains(directive.argument))
+							condition = Condition::Unknown;
+						else if ((directive.type == Directive::Type::Ifdef) == a_state.defined.contains(directive.argument))
+							condition = Condition::True;
+					}
+					openBranch(active, certain, condition);
+					break;
+				}
+			case Directive::Type::Elif:
+				if (!branches.empty()) {
+					auto& branch = branches.back();
+					auto condition = branch.parentActive && !branch.taken ? EvaluateCondition(directive.argument, a_state.defined, &a_state.unknown) : Condition::False;
+					branch.active = condition != Condition::False;
+					branch.certain = branch.parentCertain && !branch.uncertain && condition == Condition::True;
+					branch.taken |= condition == Condition::True;
+					branch.uncertain |= condition == Condition::Unknown;
+				}
+				break;
+			case Directive::Type::Else:
+				if (!branches.empty()) {
+					auto& branch = branches.back();
+					branch.active = branch.parentActive && !branch.taken;
+					branch.certain = branch.active && branch.parentCertain && !branch.uncertain;
+				}
+				break;
+			case Directive::Type::Endif:
+				if (!branches.empty())
+					branches.pop_back();
+				break;
+			}
+		}
+	}
+
+	uint64_t ShaderDependencies::HashClosure(const std::filesystem::path& a_root, std::vector<std::string> a_defines, Closure* a_closure)
+	{
+		std::sort(a_defines.begin(), a_defines.end());
+
+		WalkState state;
+		for (const auto& define : a_defines) {
+			state.defined.insert(define.substr(0, define.find('=')));
+			state.hashInput += define;
+			state.hashInput += ' ';
+		}
+		state.hashInput += '|';
+
+		std::vector<std::string> files;
+		state.closure = a_closure ? &files : nullptr;
+		Walk(a_root, a_root.parent_path(), state, 0);
+
+		if (a_closure) {
+			std::sort(files.begin(), files.end());
+			files.erase(std::unique(files.begin(), files.end()), files.end());
+			std::string closureKey;
+			for (const auto& file : files) {
+				closureKey += file;
+				closureKey += '|';
+			}
+			std::lock_guard lock(closuresMutex);
+			auto [it, inserted] = closures.try_emplace(closureKey);
+			if (inserted)
+				it->second = std::make_shared<const std::vector<std::string>>(std::move(files));
+			*a_closure = it->second;
+		}
+		return ankerl::unordered_dense::hash<std::string_view>{}(state.hashInput);
+	}
+
+	bool ShaderDependencies::Contains(const Closure& a_closure, const std::filesystem::path& a_file)
+	{
+		if (!a_closure)
+			return false;
+		auto key = GetSourceKey(a_file);
+		auto isSuffix = [](std::string_view a_long, std::string_view a_short) {
+			return a_long.ends_with(a_short) && (a_long.size() == a_short.size() || a_long[a_long.size() - a_short.size() - 1] == '/');
+		};
+		return std::any_of(a_closure->begin(), a_closure->end(), [&](const std::string& a_source) {
+			return isSuffix(key, a_source) || isSuffix(a_source, key);
+		});
+	}
+
+	void ShaderDependencies::Clear()
+	{
+		std::unique_lock lock(sourcesMutex);
+		sources.clear();
+	}
+}
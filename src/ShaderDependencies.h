@@ -0,0 +1,99 @@
+#pragma once
+
+#include <filesystem>
+#include <shared_mutex>
+
+namespace SIE
+{
+	/** @brief Tracks the preprocessor include closure of shader sources.
+	Each source file is parsed once into its preprocessor directives. A closure walk then evaluates
+	#if/#ifdef/#ifndef/#elif/#else against a define set, so only includes reachable under those defines
+	are visited. Conditions that cannot be decided from defines alone (e.g., value comparisons) are
+	treated as taken, and a #define or #undef inside such a branch makes the macro unknown rather than
+	changing it, which over-approximates the closure but never misses a dependency.
+	This has no Windows or game dependencies so it can be exercised on any host.
+	*/
+	class ShaderDependencies
+	{
+	public:
+		using DefineSet = ankerl::unordered_dense::set<std::string>;
+		using Closure = std::shared_ptr<const std::vector<std::string>>;  // sorted source keys; interned so permutations share it
+
+		struct Directive
+		{
+			enum class Type
+			{
+				Include,
+				Define,
+				Undef,
+				If,
+				Ifdef,
+				Ifndef,
+				Elif,
+				Else,
+				Endif,
+			};
+
+			Type type;
+			std::string argument;  // include path, macro name or condition expression
+		};
+
+		struct SourceFile
+		{
+			bool exists = false;
+			uint64_t contentHash = 0;
+			std::vector<Directive> directives;
+		};
+
+		/** @brief Hash the active include closure of a shader together with its define set.
+		@param  a_root The root shader source, e.g., Data/Shaders/Lighting.hlsl
+		@param  a_defines Define strings ("NAME" or "NAME=VALUE"); order does not matter
+		@param  a_closure Optional output of the set of files visited
+		@return A 64-bit content key that changes when any reachable source or define changes
+		*/
+		uint64_t HashClosure(const std::filesystem::path& a_root, std::vector<std::string> a_defines, Closure* a_closure = nullptr);
+
+		/** @brief Whether a changed file is part of a closure. Paths are compared case-insensitively and
+		relative paths match absolute ones by suffix, so watcher paths and shader paths can be mixed.
+		*/
+		static bool Contains(const Closure& a_closure, const std::filesystem::path& a_file);
+		/** @brief Normalized, lowercase, forward-slash key used to identify a source file. */
+		static std::string GetSourceKey(const std::filesystem::path& a_path);
+		void Clear();
+
+		/** @brief Resolve an #include the way D3D_COMPILE_STANDARD_FILE_INCLUDE does: relative to
+		the including file first, then relative to the root shader's directory.
+		*/
+		static std::filesystem::path ResolveInclude(const std::string& a_include, const std::filesystem::path& a_includer, const std::filesystem::path& a_rootDirectory);
+		static std::vector<Directive> ParseDirectives(std::string_view a_source);
+
+		enum class Condition
+		{
+			False,
+			True,
+			Unknown,
+		};
+
+		/** @brief Evaluate an #if/#elif expression using only which macros are defined.
+		@param  a_unknown Optional macros that may or may not be defined
+		*/
+		static Condition EvaluateCondition(std::string_view a_expression, const DefineSet& a_defined, const DefineSet* a_unknown = nullptr);
+
+	private:
+		struct WalkState
+		{
+			DefineSet defined;
+			DefineSet unknown;  // defined or undefined in a branch that may not have been taken
+			std::string hashInput;
+			std::vector<std::string>* closure = nullptr;
+		};
+
+		std::shared_ptr<const SourceFile> GetSource(const std::filesystem::path& a_path);
+		void Walk(const std::filesystem::path& a_file, const std::filesystem::path& a_rootDirectory, WalkState& a_state, int a_depth);
+
+		std::shared_mutex sourcesMutex;
+		ankerl::unordered_dense::map<std::string, std::shared_ptr<const SourceFile>> sources;
+		std::mutex closuresMutex;
+		ankerl::unordered_dense::map<std::string, Closure> closures;
+	};
+}
@@ -0,0 +1,364 @@
+#include "ShaderPack.h"
+
+#include <d3dcompiler.h>
+#include <fstream>
+
+namespace SIE
+{
+	namespace
+	{
+		std::vector<std::byte> ReadWholeFile(const std::filesystem::path& a_path)
+		{
+			std::vector<std::byte> data;
+			std::ifstream stream(a_path, std::ios::binary | std::ios::ate);
+			if (!stream.is_open())
+				return data;
+			data.resize(static_cast<size_t>(stream.tellg()));
+			stream.seekg(0);
+			stream.read(reinterpret_cast<char*>(data.data()), data.size());
+			if (!stream)
+				data.clear();
+			return data;
+		}
+
+		// Returns the entries of a pack image, or an empty span if the image is not a valid pack.
+		std::span<const ShaderPack::Entry> ParsePack(std::span<const std::byte> a_image)
+		{
+			ShaderPack::Header header;
+			if (a_image.size() < sizeof(header))
+				return {};
+			memcpy(&header, a_image.data(), sizeof(header));
+			if (header.magic != ShaderPack::Magic || header.version != ShaderPack::FormatVersion)
+				return {};
+			if (header.indexOffset < sizeof(header) || header.indexOffset > a_image.size() ||
+				header.entryCount > (a_image.size() - header.indexOffset) / sizeof(ShaderPack::Entry))
+				return {};
+
+			std::span<const ShaderPack::Entry> entries{ reinterpret_cast<const ShaderPack::Entry*>(a_image.data() + header.indexOffset), header.entryCount };
+			for (size_t i = 0; i < entries.size(); i++) {
+				const auto& entry = entries[i];
+				if (entry.offset < sizeof(header) || entry.offset > header.indexOffset || entry.size > header.indexOffset - entry.offset)
+					return {};
+				if (i > 0 && entries[i - 1].key >= entry.key)
+					return {};
+			}
+			return entries;
+		}
+	}
+
+	ShaderPack::~ShaderPack()
+	{
+		Close();
+	}
+
+	uint32_t ShaderPack::Checksum(const void* a_data, size_t a_size)
+	{
+		return static_cast<uint32_t>(ankerl::unordered_dense::detail::wyhash::hash(a_data, a_size));
+	}
+
+	bool ShaderPack::Open(const std::filesystem::path& a_path)
+	{
+		Close();
+		std::unique_lock lock(mapMutex);
+		packPath = a_path;
+		journalPath = a_path;
+		journalPath.replace_extension(".journal");
+		{
+			std::lock_guard usageLock(usageMutex);
+			usagePath = a_path;
+			usagePath.replace_extension(".usage");
+		}
+
+		LoadUsage();
+
+		if (!std::filesystem::exists(journalPath)) {
+			if (!Map() || std::none_of(index.begin(), index.end(), [&](const Entry& entry) { return IsStale(entry.key); }))
+				return !index.empty();
+			Unmap();
+		}
+		Compact();
+		return Map();
+	}
+
+	void ShaderPack::Close()
+	{
+		SaveUsage();
+		{
+			std::lock_guard lock(usageMutex);
+			usagePath.clear();
+		}
+		{
+			std::unique_lock lock(mapMutex);
+			Unmap();
+		}
+		std::lock_guard lock(journalMutex);
+		if (journal)
+			fclose(journal);
+		journal = nullptr;
+	}
+
+	void ShaderPack::Unmap()
+	{
+		index = {};
+		if (view)
+			UnmapViewOfFile(view);
+		view = nullptr;
+		viewSize = 0;
+		if (mapping)
+			CloseHandle(mapping);
+		mapping = nullptr;
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+
+	bool ShaderPack::Compact()
+	{
+		auto packImage = ReadWholeFile(packPath);
+		auto journalImage = ReadWholeFile(journalPath);
+
+		// later records win; journal records override the pack
+		std::map<uint64_t, std::pair<Entry, const std::byte*>> records;
+		size_t staleRecords = 0;
+		for (const auto& entry : ParsePack(packImage)) {
+			if (IsStale(entry.key)) {
+				staleRecords++;
+				continue;
+			}
+			records.insert_or_assign(entry.key, std::make_pair(entry, packImage.data() + entry.offset));
+		}
+
+		size_t journalRecords = 0;
+		for (size_t offset = 0; offset + sizeof(Entry) <= journalImage.size();) {
+			Entry entry;
+			memcpy(&entry, journalImage.data() + offset, sizeof(entry));
+			offset += sizeof(entry);
+			if (entry.size > journalImage.size() - offset) {
+				logger::warn("Shader pack journal truncated after {} records", journalRecords);
+				break;
+			}
+			const auto* data = journalImage.data() + offset;
+			offset += entry.size;
+			if (Checksum(data, entry.size) != entry.checksum) {
+				logger::warn("Skipping corrupt shader pack journal record {:X}", entry.key);
+				continue;
+			}
+			records.insert_or_assign(entry.key, std::make_pair(entry, data));
+			journalRecords++;
+		}
+
+		auto tempPath = packPath;
+		tempPath.replace_extension(".tmp");
+		{
+			std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+			if (!stream.is_open()) {
+				logger::error("Failed to compact shader pack: cannot write {}", tempPath.string());
+				return false;
+			}
+
+			Header header;
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			std::vector<Entry> entries;
+			entries.reserve(records.size());
+			uint64_t offset = sizeof(header);
+			for (auto& [key, record] : records) {
+				auto& [entry, data] = record;
+				stream.write(reinterpret_cast<const char*>(data), entry.size);
+				entry.offset = offset;
+				offset += entry.size;
+				entries.push_back(entry);
+			}
+
+			header.entryCount = entries.size();
+			header.indexOffset = offset;
+			stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+			stream.seekp(0);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			if (!stream) {
+				logger::error("Failed to compact shader pack: write to {} failed", tempPath.string());
+				return false;
+			}
+		}
+
+		try {
+			std::filesystem::rename(tempPath, packPath);
+			std::filesystem::remove(journalPath);
+		} catch (std::filesystem::filesystem_error const& ex) {
+			logger::error("Failed to compact shader pack: {}", ex.what());
+			return false;
+		}
+		{
+			std::lock_guard lock(usageMutex);
+			for (auto it = lastUsed.begin(); it != lastUsed.end();) {
+				if (records.contains(it->first))
+					++it;
+				else
+					it = lastUsed.erase(it);
+			}
+			usageDirty = true;
+		}
+		logger::info("Compacted shader pack: {} shaders ({} from journal, {} unused dropped)", records.size(), journalRecords, staleRecords);
+		return true;
+	}
+
+	bool ShaderPack::Map()
+	{
+		if (!std::filesystem::exists(packPath))
+			return false;
+
+		file = CreateFileW(packPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size{};
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			logger::error("Failed to open shader pack {}", packPath.string());
+			return false;
+		}
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+			view = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!view) {
+			logger::error("Failed to map shader pack {}", packPath.string());
+			return false;
+		}
+		viewSize = static_cast<uint64_t>(size.QuadPart);
+
+		index = ParsePack({ view, viewSize });
+		if (index.empty()) {
+			logger::warn("Shader pack {} is empty or corrupt", packPath.string());
+			return false;
+		}
+		logger::info("Mapped shader pack with {} shaders", index.size());
+
+		// entries without usage records, e.g., from before usage was tracked, start their count now
+		std::lock_guard lock(usageMutex);
+		for (const auto& entry : index) {
+			if (lastUsed.try_emplace(entry.key, session).second)
+				usageDirty = true;
+		}
+		return true;
+	}
+
+	void ShaderPack::LoadUsage()
+	{
+		std::lock_guard lock(usageMutex);
+		lastUsed.clear();
+		session = 0;
+		usageDirty = false;
+
+		std::ifstream stream(usagePath, std::ios::binary);
+		uint32_t magic = 0, version = 0;
+		uint64_t count = 0;
+		stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+		stream.read(reinterpret_cast<char*>(&session), sizeof(session));
+		stream.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!stream || magic != UsageMagic || version != UsageVersion) {
+			session = 0;
+		} else {
+			std::pair<uint64_t, uint32_t> usage;
+			for (uint64_t i = 0; i < count; i++) {
+				stream.read(reinterpret_cast<char*>(&usage.first), sizeof(usage.first));
+				stream.read(reinterpret_cast<char*>(&usage.second), sizeof(usage.second));
+				if (!stream)
+					break;
+				lastUsed.insert(usage);
+			}
+		}
+		session++;
+		usageDirty = true;  // the session counter advanced
+	}
+
+	void ShaderPack::SaveUsage()
+	{
+		std::lock_guard lock(usageMutex);
+		if (!usageDirty || usagePath.empty())
+			return;
+
+		std::ofstream stream(usagePath, std::ios::binary | std::ios::trunc);
+		const uint64_t count = lastUsed.size();
+		stream.write(reinterpret_cast<const char*>(&UsageMagic), sizeof(UsageMagic));
+		stream.write(reinterpret_cast<const char*>(&UsageVersion), sizeof(UsageVersion));
+		stream.write(reinterpret_cast<const char*>(&session), sizeof(session));
+		stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		for (const auto& [key, usedSession] : lastUsed) {
+			stream.write(reinterpret_cast<const char*>(&key), sizeof(key));
+			stream.write(reinterpret_cast<const char*>(&usedSession), sizeof(usedSession));
+		}
+		if (!stream) {
+			logger::error("Failed to save shader pack usage {}", usagePath.string());
+			return;
+		}
+		usageDirty = false;
+	}
+
+	void ShaderPack::MarkUsed(uint64_t a_key)
+	{
+		std::lock_guard lock(usageMutex);
+		auto& usedSession = lastUsed[a_key];
+		if (usedSession != session) {
+			usedSession = session;
+			usageDirty = true;
+		}
+	}
+
+	bool ShaderPack::IsStale(uint64_t a_key) const
+	{
+		std::lock_guard lock(usageMutex);
+		auto it = lastUsed.find(a_key);
+		return it != lastUsed.end() && session - it->second > MaxUnusedSessions;
+	}
+
+	ID3DBlob* ShaderPack::Read(uint64_t a_key, system_clock::time_point& a_timestamp)
+	{
+		std::shared_lock lock(mapMutex);
+		auto it = std::lower_bound(index.begin(), index.end(), a_key, [](const Entry& entry, uint64_t key) { return entry.key < key; });
+		if (it == index.end() || it->key != a_key)
+			return nullptr;
+
+		const auto* data = view + it->offset;
+		if (Checksum(data, it->size) != it->checksum) {
+			logger::error("Shader pack entry {:X} failed checksum", a_key);
+			return nullptr;
+		}
+
+		// copy out so blobs stay valid after the pack is closed for deletion
+		ID3DBlob* blob = nullptr;
+		if (FAILED(D3DCreateBlob(it->size, &blob)))
+			return nullptr;
+		memcpy_s(blob->GetBufferPointer(), blob->GetBufferSize(), data, it->size);
+		a_timestamp = system_clock::time_point(seconds(it->timestamp));
+		MarkUsed(a_key);
+		return blob;
+	}
+
+	bool ShaderPack::Write(uint64_t a_key, ID3DBlob* a_blob)
+	{
+		std::lock_guard lock(journalMutex);
+		if (!journal) {
+			try {
+				std::filesystem::create_directories(journalPath.parent_path());
+			} catch (std::filesystem::filesystem_error const& ex) {
+				logger::error("Failed to create folder: {}", ex.what());
+				return false;
+			}
+			if (_wfopen_s(&journal, journalPath.c_str(), L"ab") != 0 || !journal) {
+				logger::error("Failed to open shader pack journal {}", journalPath.string());
+				journal = nullptr;
+				return false;
+			}
+		}
+
+		Entry entry;
+		entry.key = a_key;
+		entry.size = static_cast<uint32_t>(a_blob->GetBufferSize());
+		entry.checksum = Checksum(a_blob->GetBufferPointer(), entry.size);
+		entry.timestamp = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+
+		bool written = fwrite(&entry, sizeof(entry), 1, journal) == 1 &&
+		               fwrite(a_blob->GetBufferPointer(), entry.size, 1, journal) == 1;
+		fflush(journal);
+		if (written)
+			MarkUsed(a_key);
+		return written;
+	}
+}
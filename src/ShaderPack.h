@@ -0,0 +1,101 @@
+#pragma once
+
+#include <d3dcommon.h>
+#include <filesystem>
+#include <shared_mutex>
+
+using namespace std::chrono;
+
+namespace SIE
+{
+	/** @brief Single-file disk cache for compiled shader blobs.
+	The pack is laid out as Header | blob data | sorted Entry index and is memory-mapped read-only.
+	Blobs compiled during a session are appended to a journal next to the pack; the journal is folded
+	into the pack (compacted) the next time the pack is opened, before it is mapped.
+	A small usage file records the last session each entry was read or written. Entries unused for
+	MaxUnusedSessions sessions are dropped at the next compaction, so keys left behind by changed
+	sources or defines do not accumulate.
+	*/
+	class ShaderPack
+	{
+	public:
+		static constexpr uint32_t Magic = 0x4B505343;  // "CSPK"
+		static constexpr uint32_t FormatVersion = 1;
+		static constexpr uint32_t UsageMagic = 0x55505343;  // "CSPU"
+		static constexpr uint32_t UsageVersion = 1;
+		static constexpr uint32_t MaxUnusedSessions = 16;
+
+#pragma pack(push, 1)
+		struct Header
+		{
+			uint32_t magic = Magic;
+			uint32_t version = FormatVersion;
+			uint64_t entryCount = 0;
+			uint64_t indexOffset = 0;
+		};
+
+		struct Entry
+		{
+			uint64_t key = 0;
+			uint64_t offset = 0;     // byte offset of the blob in the pack; unused in the journal
+			uint32_t size = 0;
+			uint32_t checksum = 0;
+			int64_t timestamp = 0;  // seconds since epoch when the blob was compiled
+		};
+#pragma pack(pop)
+
+		~ShaderPack();
+
+		/** @brief Compact any pending journal into the pack and map it.
+		@param  a_path Path of the pack file. The journal uses the same path with a .journal extension.
+		@return True if a valid pack is mapped
+		*/
+		bool Open(const std::filesystem::path& a_path);
+		/** @brief Unmap the pack and close the journal so the files can be deleted. */
+		void Close();
+
+		/** @brief Look up a blob in the mapped pack.
+		@param  a_key Cache key of the shader
+		@param  a_timestamp Set to the compile time of the blob when found
+		@return A new blob holding a copy of the packed bytecode, or nullptr if missing or corrupt
+		*/
+		ID3DBlob* Read(uint64_t a_key, system_clock::time_point& a_timestamp);
+		/** @brief Append a blob to the journal.
+		@return True if the record was written
+		*/
+		bool Write(uint64_t a_key, ID3DBlob* a_blob);
+		/** @brief Persist which entries were used this session, if that changed since the last save. */
+		void SaveUsage();
+
+		size_t GetEntryCount() const { return index.size(); }
+
+		static uint32_t Checksum(const void* a_data, size_t a_size);
+
+	private:
+		bool Compact();
+		bool Map();
+		void Unmap();  // caller holds mapMutex
+		void LoadUsage();
+		void MarkUsed(uint64_t a_key);
+		bool IsStale(uint64_t a_key) const;
+
+		std::filesystem::path packPath;
+		std::filesystem::path journalPath;
+		std::filesystem::path usagePath;
+
+		mutable std::shared_mutex mapMutex;
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+		const std::byte* view = nullptr;
+		uint64_t viewSize = 0;
+		std::span<const Entry> index;
+
+		std::mutex journalMutex;
+		FILE* journal = nullptr;
+
+		mutable std::mutex usageMutex;
+		ankerl::unordered_dense::map<uint64_t, uint32_t> lastUsed;  // key -> session
+		uint32_t session = 0;
+		bool usageDirty = false;
+	};
+}
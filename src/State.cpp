@@ -6,7 +6,9 @@
 #include "Menu.h"
 #include "ShaderCache.h"
 
+#include "BindingCache.h"
 #include "Feature.h"
+#include "FrameConstants.h"
 #include "Util.h"
 
 #include "Features/TerrainBlending.h"
@@ -18,6 +20,9 @@ void State::Draw()
 		auto type = currentShader->shaderType.get();
 		if (type > 0 && type < RE::BSShader::Type::Total) {
 			if (enabledClasses[type - 1]) {
+				auto bindingCache = BindingCache::GetSingleton();
+				bindingCache->InvalidateGameSlots();
+
 				ModifyShaderLookup(*currentShader, currentVertexDescriptor, currentPixelDescriptor);
 				UpdateSharedData(currentShader, currentPixelDescriptor);
 
@@ -32,24 +37,29 @@ void State::Draw()
 					context->PSSetShader(reinterpret_cast<ID3D11PixelShader*>(pixelShader->shader), NULL, NULL);
 				}
 
-				BeginPerfEvent(std::format("Draw: CommunityShaders {}::{}", magic_enum::enum_name(currentShader->shaderType.get()), currentPixelDescriptor));
-				if (IsDeveloperMode()) {
-					SetPerfMarker(std::format("Defines: {}", SIE::ShaderCache::GetDefinesString(currentShader->shaderType.get(), currentPixelDescriptor)));
+				auto annotate = perfAnnotationActive;
+				if (annotate) {
+					BeginPerfEvent(GetDrawPerfLabel(type, currentPixelDescriptor));
+					if (IsDeveloperMode())
+						SetPerfMarker(GetDefinesPerfLabel(type, currentPixelDescriptor));
 				}
 
 				if (vertexShader && pixelShader) {
-					for (auto* feature : Feature::GetFeatureList()) {
-						if (feature->loaded) {
-							auto hasShaderDefine = feature->HasShaderDefine(currentShader->shaderType.get());
-							if (hasShaderDefine)
-								BeginPerfEvent(feature->GetShortName());
-							feature->Draw(currentShader, currentPixelDescriptor);
-							if (hasShaderDefine)
-								EndPerfEvent();
-						}
+					if (featureDispatchDirty)
+						BuildFeatureDispatch();
+					for (auto& [feature, hasShaderDefine] : drawDispatch[type]) {
+						auto annotateFeature = annotate && hasShaderDefine;
+						if (annotateFeature)
+							BeginPerfEvent(GetFeaturePerfLabel(feature));
+						feature->Draw(currentShader, currentPixelDescriptor);
+						if (annotateFeature)
+							EndPerfEvent();
 					}
 				}
-				EndPerfEvent();
+				bindingCache->Flush(context);
+
+				if (annotate)
+					EndPerfEvent();
 			}
 		}
 	}
@@ -58,6 +68,11 @@ void State::Draw()
 
 void State::DrawDeferred()
 {
+	if (featureDispatchDirty)
+		BuildFeatureDispatch();
+	if (deferredDispatch.empty())
+		return;
+
 	ID3D11ShaderResourceView* srvs[8];
 	context->PSGetShaderResources(0, 8, srvs);
 
@@ -82,16 +97,14 @@ void State::DrawDeferred()
 	ID3D11DepthStencilView* nullDsv = nullptr;
 	context->OMSetRenderTargets(8, nullViews, nullDsv);
 
-	for (auto* feature : Feature::GetFeatureList()) {
-		if (feature->loaded) {
-			feature->DrawDeferred();
-		}
-	}
+	for (auto* feature : deferredDispatch)
+		feature->DrawDeferred();
 
 	context->PSSetShaderResources(0, 8, srvs);
 	context->CSSetShaderResources(0, 8, srvsCS);
 	context->CSSetUnorderedAccessViews(0, 8, uavsCS, nullptr);
 	context->OMSetRenderTargets(8, views, dsv);
+	BindingCache::GetSingleton()->InvalidateShaderResources();
 
 	for (int i = 0; i < 8; i++) {
 		if (srvs[i])
@@ -111,6 +124,11 @@ void State::DrawDeferred()
 
 void State::DrawPreProcess()
 {
+	if (featureDispatchDirty)
+		BuildFeatureDispatch();
+	if (preProcessDispatch.empty())
+		return;
+
 	ID3D11ShaderResourceView* srvs[8];
 	context->PSGetShaderResources(0, 8, srvs);
 
@@ -135,16 +153,14 @@ void State::DrawPreProcess()
 	ID3D11DepthStencilView* nullDsv = nullptr;
 	context->OMSetRenderTargets(8, nullViews, nullDsv);
 
-	for (auto* feature : Feature::GetFeatureList()) {
-		if (feature->loaded) {
-			feature->DrawPreProcess();
-		}
-	}
+	for (auto* feature : preProcessDispatch)
+		feature->DrawPreProcess();
 
 	context->PSSetShaderResources(0, 8, srvs);
 	context->CSSetShaderResources(0, 8, srvsCS);
 	context->CSSetUnorderedAccessViews(0, 8, uavsCS, nullptr);
 	context->OMSetRenderTargets(8, views, dsv);
+	BindingCache::GetSingleton()->InvalidateShaderResources();
 
 	for (int i = 0; i < 8; i++) {
 		if (srvs[i])
@@ -162,6 +178,31 @@ void State::DrawPreProcess()
 		dsv->Release();
 }
 
+void State::BuildFeatureDispatch()
+{
+	featureDispatchDirty = false;
+	// defines labels embed the feature and user defines, which may have changed with the dispatch
+	definesPerfLabels.clear();
+	for (auto& list : drawDispatch)
+		list.clear();
+	deferredDispatch.clear();
+	preProcessDispatch.clear();
+
+	for (auto* feature : Feature::GetFeatureList()) {
+		if (!feature->loaded)
+			continue;
+		for (int type = 1; type < RE::BSShader::Type::Total; type++) {
+			auto shaderType = static_cast<RE::BSShader::Type>(type);
+			if (feature->HasDraw(shaderType))
+				drawDispatch[type].push_back({ feature, feature->HasShaderDefine(shaderType) });
+		}
+		if (feature->HasDrawDeferred())
+			deferredDispatch.push_back(feature);
+		if (feature->HasDrawPreProcess())
+			preProcessDispatch.push_back(feature);
+	}
+}
+
 void State::Reset()
 {
 	lightingDataRequiresUpdate = true;
@@ -169,8 +210,14 @@ void State::Reset()
 		if (feature->loaded)
 			feature->Reset();
 	Bindings::GetSingleton()->Reset();
+	FrameConstants::GetSingleton()->Reset();
+	BindingCache::GetSingleton()->Reset();
 	if (!RE::UI::GetSingleton()->GameIsPaused())
 		timer += RE::GetSecondsSinceLastFrame();
+	SIE::ShaderCache::Instance().CollectRetiredShaders();
+	SIE::ShaderCache::Instance().UpdateShaderManifest();
+	perfAnnotationActive = pPerf && pPerf->GetStatus();
+	perfLabelAllocationsLastFrame = std::exchange(perfLabelAllocations, 0);
 }
 
 void State::Setup()
@@ -250,6 +297,8 @@ void State::Load(ConfigMode a_configMode)
 			shaderCache.backgroundCompilationThreadCount = std::clamp(advanced["Background Compiler Threads"].get<int32_t>(), 1, static_cast<int32_t>(std::thread::hardware_concurrency()));
 		if (advanced["Use FileWatcher"].is_boolean())
 			shaderCache.SetFileWatcher(advanced["Use FileWatcher"]);
+		if (advanced["Precompile From Manifest"].is_boolean())
+			shaderCache.SetPrecompileFromManifest(advanced["Precompile From Manifest"]);
 	}
 
 	if (settings["General"].is_object()) {
@@ -277,6 +326,7 @@ void State::Load(ConfigMode a_configMode)
 
 	for (auto* feature : Feature::GetFeatureList())
 		feature->Load(settings);
+	InvalidateFeatureDispatch();
 	i.close();
 	if (settings["Version"].is_string() && settings["Version"].get<std::string>() != Plugin::VERSION.string()) {
 		logger::info("Found older config for version {}; upgrading to {}", (std::string)settings["Version"], Plugin::VERSION.string());
@@ -300,6 +350,7 @@ void State::Save(ConfigMode a_configMode)
 	advanced["Compiler Threads"] = shaderCache.compilationThreadCount;
 	advanced["Background Compiler Threads"] = shaderCache.backgroundCompilationThreadCount;
 	advanced["Use FileWatcher"] = shaderCache.UseFileWatcher();
+	advanced["Precompile From Manifest"] = shaderCache.IsPrecompileFromManifest();
 	settings["Advanced"] = advanced;
 
 	json general;
@@ -385,6 +436,7 @@ void State::SetDefines(std::string a_defines)
 	}
 	shaderDefinesString = shaderDefinesString.substr(0, shaderDefinesString.size() - 1);
 	logger::debug("Shader Defines set to {}", shaderDefinesString);
+	InvalidateFeatureDispatch();
 }
 
 std::vector<std::pair<std::string, std::string>>* State::GetDefines()
@@ -548,25 +600,81 @@ void State::ModifyShaderLookup(const RE::BSShader& a_shader, uint& a_vertexDescr
 		}
 
 		ID3D11ShaderResourceView* view = shaderDataBuffer->srv.get();
-		context->PSSetShaderResources(127, 1, &view);
+		BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 127, 1, &view);
 	}
 }
 
 void State::BeginPerfEvent(std::string_view title)
 {
+	if (!perfAnnotationActive)
+		return;
+	perfLabelAllocations++;
 	pPerf->BeginEvent(std::wstring(title.begin(), title.end()).c_str());
 }
 
+void State::BeginPerfEvent(const std::wstring& title)
+{
+	if (perfAnnotationActive)
+		pPerf->BeginEvent(title.c_str());
+}
+
 void State::EndPerfEvent()
 {
-	pPerf->EndEvent();
+	if (perfAnnotationActive)
+		pPerf->EndEvent();
 }
 
 void State::SetPerfMarker(std::string_view title)
 {
+	if (!perfAnnotationActive)
+		return;
+	perfLabelAllocations++;
 	pPerf->SetMarker(std::wstring(title.begin(), title.end()).c_str());
 }
 
+void State::SetPerfMarker(const std::wstring& title)
+{
+	if (perfAnnotationActive)
+		pPerf->SetMarker(title.c_str());
+}
+
+static std::wstring ToPerfLabel(std::string_view a_label)
+{
+	return std::wstring(a_label.begin(), a_label.end());
+}
+
+const std::wstring& State::GetDrawPerfLabel(RE::BSShader::Type a_type, uint32_t a_descriptor)
+{
+	auto key = (static_cast<uint64_t>(a_type) << 32) | a_descriptor;
+	auto [it, inserted] = drawPerfLabels.try_emplace(key);
+	if (inserted) {
+		perfLabelAllocations++;
+		it->second = ToPerfLabel(std::format("Draw: CommunityShaders {}::{}", magic_enum::enum_name(a_type), a_descriptor));
+	}
+	return it->second;
+}
+
+const std::wstring& State::GetDefinesPerfLabel(RE::BSShader::Type a_type, uint32_t a_descriptor)
+{
+	auto key = (static_cast<uint64_t>(a_type) << 32) | a_descriptor;
+	auto [it, inserted] = definesPerfLabels.try_emplace(key);
+	if (inserted) {
+		perfLabelAllocations++;
+		it->second = ToPerfLabel(std::format("Defines: {}", SIE::ShaderCache::GetDefinesString(a_type, a_descriptor)));
+	}
+	return it->second;
+}
+
+const std::wstring& State::GetFeaturePerfLabel(Feature* a_feature)
+{
+	auto [it, inserted] = featurePerfLabels.try_emplace(a_feature);
+	if (inserted) {
+		perfLabelAllocations++;
+		it->second = ToPerfLabel(a_feature->GetShortName());
+	}
+	return it->second;
+}
+
 void State::UpdateSharedData(const RE::BSShader* a_shader, const uint32_t)
 {
 	if (a_shader->shaderType.get() == RE::BSShader::Type::Lighting) {
@@ -619,10 +727,10 @@ void State::UpdateSharedData(const RE::BSShader* a_shader, const uint32_t)
 			context->Unmap(lightingDataBuffer->resource.get(), 0);
 
 			ID3D11ShaderResourceView* view = lightingDataBuffer->srv.get();
-			context->PSSetShaderResources(126, 1, &view);
+			BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 126, 1, &view);
 
 			view = renderer->GetDepthStencilData().depthStencils[RE::RENDER_TARGETS_DEPTHSTENCIL::kPOST_ZPREPASS_COPY].depthSRV;
-			context->PSSetShaderResources(20, 1, &view);
+			BindingCache::GetSingleton()->SetShaderResources(BindingCache::Stage::Pixel, 20, 1, &view);
 		}
 	}
 }
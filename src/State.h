@@ -4,6 +4,8 @@
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
+struct Feature;
+
 class State
 {
 public:
@@ -41,6 +43,11 @@ public:
 	void Draw();
 	void DrawDeferred();
 	void DrawPreProcess();
+	/**
+	 * Mark the feature dispatch lists stale, e.g. after features are loaded or toggled or defines change.
+	 * They are rebuilt, and cached defines perf labels dropped, before the next draw.
+	 */
+	void InvalidateFeatureDispatch() { featureDispatchDirty = true; }
 	void Reset();
 	void Setup();
 
@@ -91,8 +98,20 @@ public:
 	void ModifyShaderLookup(const RE::BSShader& a_shader, uint& a_vertexDescriptor, uint& a_pixelDescriptor);
 
 	void BeginPerfEvent(std::string_view title);
+	void BeginPerfEvent(const std::wstring& title);
 	void EndPerfEvent();
 	void SetPerfMarker(std::string_view title);
+	void SetPerfMarker(const std::wstring& title);
+
+	/**
+	 * @brief Whether a graphics debugger or profiler is listening for annotations.
+	 * Sampled once per frame in Reset so begin/end events stay balanced within a frame.
+	 * All perf events and markers are skipped when this is false.
+	 */
+	bool IsPerfAnnotationActive() const { return perfAnnotationActive; }
+
+	uint32_t perfLabelAllocations = 0;           // strings built for perf annotations this frame
+	uint32_t perfLabelAllocationsLastFrame = 0;  // shown in the Statistics menu
 
 	struct PerShader
 	{
@@ -132,4 +151,27 @@ public:
 
 private:
 	std::shared_ptr<REX::W32::ID3DUserDefinedAnnotation> pPerf;
+	bool perfAnnotationActive = false;
+
+	// Perf labels are built once and reused so annotating a draw does not allocate.
+	const std::wstring& GetDrawPerfLabel(RE::BSShader::Type a_type, uint32_t a_descriptor);
+	const std::wstring& GetDefinesPerfLabel(RE::BSShader::Type a_type, uint32_t a_descriptor);
+	const std::wstring& GetFeaturePerfLabel(Feature* a_feature);
+
+	ankerl::unordered_dense::map<uint64_t, std::wstring> drawPerfLabels;
+	ankerl::unordered_dense::map<uint64_t, std::wstring> definesPerfLabels;
+	ankerl::unordered_dense::map<Feature*, std::wstring> featurePerfLabels;
+
+	struct DrawDispatch
+	{
+		Feature* feature;
+		bool hasShaderDefine;
+	};
+
+	// Loaded features taking part in each hook, so a draw only visits the features it affects.
+	void BuildFeatureDispatch();
+	bool featureDispatchDirty = true;
+	std::array<std::vector<DrawDispatch>, RE::BSShader::Type::Total> drawDispatch;
+	std::vector<Feature*> deferredDispatch;
+	std::vector<Feature*> preProcessDispatch;
 };